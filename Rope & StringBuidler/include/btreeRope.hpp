@@ -0,0 +1,114 @@
+#ifndef BTREEROPE_HPP
+#define BTREEROPE_HPP
+
+#pragma once
+#include "rope.hpp"
+
+using namespace std;
+
+/*
+ * Rope stored as a B+-tree.
+ * Internal nodes hold up to MAX_CHILDREN children with the cumulative weights of the
+ * children in a contiguous array, so finding the child holding a position scans one
+ * cache-friendly array instead of chasing a pointer per level. The text lives in the
+ * leaves only, in fixed blocks of MIN_LEAF_SIZE to MAX_LEAF_SIZE bytes, and every leaf
+ * is at the same depth. The public API mirrors Rope so the two can be benchmarked
+ * against each other with the same workload.
+ */
+class BTreeRope {
+public:
+    typedef Rope::Size Size;
+
+private:
+    static constexpr uint32_t MIN_CHILDREN = 8;
+    static constexpr uint32_t MAX_CHILDREN = 32;
+    static constexpr uint32_t MIN_LEAF_SIZE = 1024;
+    static constexpr uint32_t MAX_LEAF_SIZE = 4096;
+
+    struct Node {
+        bool isLeaf;
+
+        explicit Node(bool isLeaf) : isLeaf(isLeaf) {}
+    };
+
+    struct Leaf : Node {
+        uint32_t length;
+        char text[MAX_LEAF_SIZE];
+
+        Leaf() : Node(true), length(0) {}
+    };
+
+    struct Internal : Node {
+        uint32_t count;
+        Size weights[MAX_CHILDREN]; // weights[i] is the length of children 0 to i together
+        Node* children[MAX_CHILDREN];
+
+        Internal() : Node(false), count(0) {}
+    };
+
+    Node* root;
+
+    static Size lengthOf(const Node* node);
+    static bool isUnderfull(const Node* node);
+    static void updateWeights(Internal* node);
+    static uint32_t findChild(const Internal* node, Size pos, bool preferLeft);
+
+    static Node* cloneTree(const Node* node);
+    static void destroyTree(Node* node);
+
+    static void fillLeaves(Leaf* first, const char* text, Size len, vector<Node*>& overflow);
+    static void fillInternal(Internal* first, vector<Node*>& children, vector<Node*>& overflow);
+
+    static void insertInto(Node* node, Size pos, const char* str, Size len, vector<Node*>& overflow);
+    static void removeFrom(Node* node, Size start, Size len);
+    static void fixUnderfull(Internal* node);
+    static void mergeSiblings(Internal* node, uint32_t index);
+
+    static void copyText(const Node* node, Size start, Size len, string& out);
+
+public:
+    BTreeRope();
+    BTreeRope(const char str[], Size len);
+    BTreeRope(const char filename[]);
+    ~BTreeRope();
+
+    BTreeRope(const BTreeRope& orig) : root(cloneTree(orig.root)) {}
+
+    BTreeRope& operator =(const BTreeRope& orig) {
+        if (this != &orig) {
+            destroyTree(root);
+            root = cloneTree(orig.root);
+        }
+        return *this;
+    }
+
+    void append(const BTreeRope& rope);
+    void append(const char s[], Size len);
+
+    void prepend(const BTreeRope& rope);
+    void prepend(const char s[], Size len);
+
+    void insert(Size pos, const BTreeRope& rope);
+    void insert(Size pos, const char s[], Size len);
+
+    void remove(Size pos);
+    void remove(Size start, Size length);
+
+    BTreeRope* cut(Size start, Size length);
+    void paste(Size start, const BTreeRope* r);
+
+    void load(const char filename[]);
+    void save(const char filename[]);
+
+    Size getLength() const;
+    uint32_t getHeight() const;
+
+    uint32_t getLeafCount() const;
+    double memoryOverhead() const;
+
+    string toString() const;
+
+    void printTree();
+};
+
+#endif // BTREEROPE_HPP
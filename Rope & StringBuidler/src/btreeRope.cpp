@@ -0,0 +1,909 @@
+#include "btreeRope.hpp"
+
+/*
+ * BTreeRope class implementation
+ * Copyright (C) 2022 dhruv
+*/
+
+/**
+ * Constructor for the BTreeRope class. Initializes an empty rope made of a single empty leaf.
+ *
+ * @throws std::bad_alloc if the leaf cannot be allocated.
+ */
+BTreeRope::BTreeRope() : root(new Leaf()) {}
+
+/**
+ * Constructor for the BTreeRope class. Initializes a new rope with a given string and length.
+ *
+ * @param str The string to initialize the rope with.
+ * @param len The length of the string.
+ *
+ * @throws std::bad_alloc if the nodes cannot be allocated.
+ */
+BTreeRope::BTreeRope(const char str[], Size len) : root(new Leaf())
+{
+    insert(0, str, len);
+}
+
+/**
+ * Constructor for the BTreeRope class. Reads a file and creates a new rope with its contents.
+ *
+ * @param filename The name of the file to read.
+ *
+ * @throws std::bad_alloc if the nodes cannot be allocated.
+ */
+BTreeRope::BTreeRope(const char filename[]) : root(new Leaf())
+{
+    load(filename);
+}
+
+/**
+ * Destructor for the BTreeRope class. Frees every node of the tree.
+ *
+ * @throws None
+ */
+BTreeRope::~BTreeRope()
+{
+    destroyTree(root);
+    root = nullptr;
+}
+
+/*
+* NODE HELPER FUNCTIONS
+* =====================
+* - lengthOf
+* - isUnderfull
+* - updateWeights
+* - findChild
+* - cloneTree
+* - destroyTree
+*/
+
+/**
+ * Retrieves the number of bytes in a subtree.
+ *
+ * @param node The root of the subtree.
+ *
+ * @return The length of the text the subtree holds.
+ *
+ * @throws None
+ */
+BTreeRope::Size BTreeRope::lengthOf(const Node* node)
+{
+    if (node->isLeaf) {
+        return static_cast<const Leaf*>(node)->length;
+    }
+
+    const Internal* inner = static_cast<const Internal*>(node);
+    return inner->count > 0 ? inner->weights[inner->count - 1] : 0;
+}
+
+/**
+ * Checks whether a non-root node is below the minimum fill of its kind.
+ *
+ * @param node The node to check.
+ *
+ * @return true if the node should be merged with a sibling, false otherwise.
+ *
+ * @throws None
+ */
+bool BTreeRope::isUnderfull(const Node* node)
+{
+    if (node->isLeaf) {
+        return static_cast<const Leaf*>(node)->length < MIN_LEAF_SIZE;
+    }
+    return static_cast<const Internal*>(node)->count < MIN_CHILDREN;
+}
+
+/**
+ * Recomputes the cumulative weights of an internal node from its children.
+ *
+ * @param node The internal node.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::updateWeights(Internal* node)
+{
+    Size total = 0;
+    for (uint32_t i = 0; i < node->count; i++) {
+        total += lengthOf(node->children[i]);
+        node->weights[i] = total;
+    }
+}
+
+/**
+ * Finds the child of an internal node holding a position by scanning the cumulative weights.
+ *
+ * @param node The internal node.
+ * @param pos The position inside the node.
+ * @param preferLeft Whether a position on the boundary between two children belongs to the
+ *                   left one (to insert at its end) rather than the right one.
+ *
+ * @return The index of the child.
+ *
+ * @throws None
+ */
+uint32_t BTreeRope::findChild(const Internal* node, Size pos, bool preferLeft)
+{
+    uint32_t i = 0;
+    while (i + 1 < node->count && (preferLeft ? node->weights[i] < pos : node->weights[i] <= pos)) {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * Copies a whole subtree.
+ *
+ * @param node The root of the subtree to copy.
+ *
+ * @return The root of the copy.
+ *
+ * @throws std::bad_alloc if the nodes cannot be allocated.
+ */
+BTreeRope::Node* BTreeRope::cloneTree(const Node* node)
+{
+    if (node->isLeaf) {
+        const Leaf* leaf = static_cast<const Leaf*>(node);
+        Leaf* copy = new Leaf();
+        memcpy(copy->text, leaf->text, leaf->length);
+        copy->length = leaf->length;
+        return copy;
+    }
+
+    const Internal* inner = static_cast<const Internal*>(node);
+    Internal* copy = new Internal();
+    for (uint32_t i = 0; i < inner->count; i++) {
+        copy->children[i] = cloneTree(inner->children[i]);
+        copy->weights[i] = inner->weights[i];
+    }
+    copy->count = inner->count;
+    return copy;
+}
+
+/**
+ * Frees a whole subtree. The tree is only a few levels deep, so recursion is safe.
+ *
+ * @param node The root of the subtree, may be nullptr.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::destroyTree(Node* node)
+{
+    if (node == nullptr) return;
+
+    if (node->isLeaf) {
+        delete static_cast<Leaf*>(node);
+        return;
+    }
+
+    Internal* inner = static_cast<Internal*>(node);
+    for (uint32_t i = 0; i < inner->count; i++) {
+        destroyTree(inner->children[i]);
+    }
+    delete inner;
+}
+
+/*
+* NODE SPLITTING FUNCTIONS
+* ========================
+* A node that overflows is split into as few nodes as can hold its content, and the
+* content is spread evenly so every new node is at least half full. The nodes after the
+* first are handed to the parent as new siblings, a root that overflows grows a new level.
+* - fillLeaves
+* - fillInternal
+* - insertInto
+*/
+
+/**
+ * Spreads text evenly over as few leaves as can hold it.
+ *
+ * @param first The leaf receiving the first part of the text.
+ * @param text The text.
+ * @param len The length of the text.
+ * @param overflow Receives the new leaves after the first one, in order.
+ *
+ * @return void
+ *
+ * @throws std::bad_alloc if the leaves cannot be allocated.
+ */
+void BTreeRope::fillLeaves(Leaf* first, const char* text, Size len, vector<Node*>& overflow)
+{
+    Size leaves = max<Size>((len + MAX_LEAF_SIZE - 1) / MAX_LEAF_SIZE, 1);
+
+    for (Size k = 0; k < leaves; k++) {
+        Size begin = len * k / leaves;
+        Size end = len * (k + 1) / leaves;
+
+        Leaf* leaf = k == 0 ? first : new Leaf();
+        memcpy(leaf->text, text + begin, end - begin);
+        leaf->length = uint32_t(end - begin);
+
+        if (k > 0) {
+            overflow.push_back(leaf);
+        }
+    }
+}
+
+/**
+ * Spreads children evenly over as few internal nodes as can hold them.
+ *
+ * @param first The node receiving the first children.
+ * @param children The children, in order.
+ * @param overflow Receives the new internal nodes after the first one, in order.
+ *
+ * @return void
+ *
+ * @throws std::bad_alloc if the nodes cannot be allocated.
+ */
+void BTreeRope::fillInternal(Internal* first, vector<Node*>& children, vector<Node*>& overflow)
+{
+    size_t total = children.size();
+    size_t nodes = max<size_t>((total + MAX_CHILDREN - 1) / MAX_CHILDREN, 1);
+
+    for (size_t k = 0; k < nodes; k++) {
+        size_t begin = total * k / nodes;
+        size_t end = total * (k + 1) / nodes;
+
+        Internal* node = k == 0 ? first : new Internal();
+        copy(children.begin() + begin, children.begin() + end, node->children);
+        node->count = uint32_t(end - begin);
+        updateWeights(node);
+
+        if (k > 0) {
+            overflow.push_back(node);
+        }
+    }
+}
+
+/**
+ * Inserts text into a subtree.
+ *
+ * @param node The root of the subtree.
+ * @param pos The position of the insertion inside the subtree.
+ * @param str The text to insert.
+ * @param len The length of the text.
+ * @param overflow Receives the siblings the node had to be split into, in order.
+ *
+ * @return void
+ *
+ * @throws std::bad_alloc if the nodes cannot be allocated.
+ */
+void BTreeRope::insertInto(Node* node, Size pos, const char* str, Size len, vector<Node*>& overflow)
+{
+    if (node->isLeaf) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        uint32_t at = uint32_t(pos);
+
+        if (leaf->length + len <= MAX_LEAF_SIZE) { // Fits, shift the tail in place
+            memmove(leaf->text + at + len, leaf->text + at, leaf->length - at);
+            memcpy(leaf->text + at, str, len);
+            leaf->length += uint32_t(len);
+            return;
+        }
+
+        string text;
+        text.reserve(leaf->length + len);
+        text.append(leaf->text, at);
+        text.append(str, len);
+        text.append(leaf->text + at, leaf->length - at);
+
+        fillLeaves(leaf, text.data(), text.size(), overflow);
+        return;
+    }
+
+    Internal* inner = static_cast<Internal*>(node);
+    uint32_t i = findChild(inner, pos, true);
+    Size childStart = i > 0 ? inner->weights[i - 1] : 0;
+
+    vector<Node*> childOverflow;
+    insertInto(inner->children[i], pos - childStart, str, len, childOverflow);
+
+    if (childOverflow.empty()) {
+        for (uint32_t j = i; j < inner->count; j++) {
+            inner->weights[j] += len;
+        }
+        return;
+    }
+
+    vector<Node*> children(inner->children, inner->children + inner->count);
+    children.insert(children.begin() + i + 1, childOverflow.begin(), childOverflow.end());
+
+    fillInternal(inner, children, overflow);
+}
+
+/*
+* NODE MERGING FUNCTIONS
+* ======================
+* Removing text can leave the nodes at both ends of the removed range below their
+* minimum fill. Such a node is merged with a sibling, or shares the content of the
+* sibling evenly when both together would not fit in one node.
+* - removeFrom
+* - fixUnderfull
+* - mergeSiblings
+*/
+
+/**
+ * Removes a range of text from a subtree. The range is never the whole subtree.
+ *
+ * @param node The root of the subtree.
+ * @param start The start of the range inside the subtree.
+ * @param len The length of the range, greater than 0.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::removeFrom(Node* node, Size start, Size len)
+{
+    if (node->isLeaf) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        uint32_t from = uint32_t(start);
+        uint32_t to = uint32_t(start + len);
+
+        memmove(leaf->text + from, leaf->text + to, leaf->length - to);
+        leaf->length -= to - from;
+        return;
+    }
+
+    Internal* inner = static_cast<Internal*>(node);
+    Size end = start + len;
+    Size childStart = 0;
+    uint32_t kept = 0;
+
+    for (uint32_t i = 0; i < inner->count; i++) {
+        Node* child = inner->children[i];
+        Size childEnd = inner->weights[i];
+
+        if (childEnd <= start || childStart >= end) { // Outside the range
+            inner->children[kept++] = child;
+        }
+        else if (start <= childStart && childEnd <= end) { // Entirely inside the range
+            destroyTree(child);
+        }
+        else {
+            Size from = max(start, childStart);
+            Size to = min(end, childEnd);
+            removeFrom(child, from - childStart, to - from);
+            inner->children[kept++] = child;
+        }
+
+        childStart = childEnd;
+    }
+
+    inner->count = kept;
+    updateWeights(inner);
+    fixUnderfull(inner);
+}
+
+/**
+ * Merges every underfull child of an internal node with one of its siblings.
+ *
+ * @param node The internal node.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::fixUnderfull(Internal* node)
+{
+    uint32_t i = 0;
+
+    while (i < node->count && node->count > 1) {
+        if (!isUnderfull(node->children[i])) {
+            i++;
+            continue;
+        }
+
+        // Merge with the next sibling, or the previous one for the last child, then look again
+        // since a merged node can still be underfull
+        uint32_t left = i + 1 < node->count ? i : i - 1;
+        mergeSiblings(node, left);
+        i = left;
+    }
+
+    updateWeights(node);
+}
+
+/**
+ * Merges two neighbouring children, or spreads their content evenly over both when it does not fit in one.
+ *
+ * @param node The parent of the two children.
+ * @param index The index of the first child, the second one follows it.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::mergeSiblings(Internal* node, uint32_t index)
+{
+    Node* first = node->children[index];
+    Node* second = node->children[index + 1];
+    bool merged = false;
+
+    if (first->isLeaf) {
+        Leaf* a = static_cast<Leaf*>(first);
+        Leaf* b = static_cast<Leaf*>(second);
+        uint32_t total = a->length + b->length;
+
+        if (total <= MAX_LEAF_SIZE) {
+            memcpy(a->text + a->length, b->text, b->length);
+            a->length = total;
+            delete b;
+            merged = true;
+        }
+        else {
+            char text[2 * MAX_LEAF_SIZE];
+            memcpy(text, a->text, a->length);
+            memcpy(text + a->length, b->text, b->length);
+
+            a->length = total / 2;
+            b->length = total - a->length;
+            memcpy(a->text, text, a->length);
+            memcpy(b->text, text + a->length, b->length);
+        }
+    }
+    else {
+        Internal* a = static_cast<Internal*>(first);
+        Internal* b = static_cast<Internal*>(second);
+        uint32_t total = a->count + b->count;
+
+        if (total <= MAX_CHILDREN) {
+            copy(b->children, b->children + b->count, a->children + a->count);
+            a->count = total;
+            updateWeights(a);
+            delete b;
+            merged = true;
+        }
+        else {
+            Node* children[2 * MAX_CHILDREN];
+            copy(a->children, a->children + a->count, children);
+            copy(b->children, b->children + b->count, children + a->count);
+
+            a->count = total / 2;
+            b->count = total - a->count;
+            copy(children, children + a->count, a->children);
+            copy(children + a->count, children + total, b->children);
+            updateWeights(a);
+            updateWeights(b);
+        }
+    }
+
+    if (merged) {
+        copy(node->children + index + 2, node->children + node->count, node->children + index + 1);
+        node->count--;
+    }
+
+    updateWeights(node);
+}
+
+/**
+ * Appends part of the text of a subtree to a string.
+ *
+ * @param node The root of the subtree.
+ * @param start The start of the part inside the subtree.
+ * @param len The length of the part.
+ * @param out The string receiving the text.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::copyText(const Node* node, Size start, Size len, string& out)
+{
+    if (len == 0) return;
+
+    if (node->isLeaf) {
+        out.append(static_cast<const Leaf*>(node)->text + start, len);
+        return;
+    }
+
+    const Internal* inner = static_cast<const Internal*>(node);
+    Size end = start + len;
+    Size childStart = 0;
+
+    for (uint32_t i = 0; i < inner->count && childStart < end; i++) {
+        Size childEnd = inner->weights[i];
+
+        if (childEnd > start) {
+            Size from = max(start, childStart);
+            Size to = min(end, childEnd);
+            copyText(inner->children[i], from - childStart, to - from, out);
+        }
+
+        childStart = childEnd;
+    }
+}
+
+/*
+ * BTreeRope Functions
+ * ===================
+ * These functions mirror the public API of Rope.
+*/
+
+/**
+ * Appends the given rope to the end of this rope.
+ *
+ * @param rope The rope to append to this rope.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::append(const BTreeRope& rope)
+{
+    insert(getLength(), rope);
+}
+
+/**
+ * Appends the given string to the end of the rope.
+ *
+ * @param str The string to append.
+ * @param len The length of the string.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::append(const char str[], Size len)
+{
+    insert(getLength(), str, len);
+}
+
+/**
+ * Prepends the given rope to the beginning of this rope.
+ *
+ * @param rope The rope to prepend to this rope.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::prepend(const BTreeRope& rope)
+{
+    insert(0, rope);
+}
+
+/**
+ * Prepends the given string to the beginning of the rope.
+ *
+ * @param str The string to prepend.
+ * @param len The length of the string.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::prepend(const char str[], Size len)
+{
+    insert(0, str, len);
+}
+
+/**
+ * Inserts a rope at the specified position in the rope. The text of the rope is copied.
+ *
+ * @param pos The position at which the rope should be inserted.
+ * @param rope The rope to be inserted.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::insert(Size pos, const BTreeRope& rope)
+{
+    string text = rope.toString();
+    insert(pos, text.data(), text.length());
+}
+
+/**
+ * Inserts a new string at the specified position in the rope.
+ *
+ * @param pos The position at which the string should be inserted, positions past the end append.
+ * @param str The string to be inserted.
+ * @param len The length of the string.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::insert(Size pos, const char str[], Size len)
+{
+    if (len == 0) return;
+
+    vector<Node*> overflow;
+    insertInto(root, min(pos, getLength()), str, len, overflow);
+
+    while (!overflow.empty()) { // The root was split, grow a new level above it
+        vector<Node*> children = {root};
+        children.insert(children.end(), overflow.begin(), overflow.end());
+        overflow.clear();
+
+        Internal* newRoot = new Internal();
+        fillInternal(newRoot, children, overflow);
+        root = newRoot;
+    }
+}
+
+/**
+ * Removes a character at the specified position from the rope.
+ *
+ * @param pos The position of the character to be removed.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::remove(Size pos)
+{
+    remove(pos, 1);
+}
+
+/**
+ * Removes a range of characters from the rope.
+ *
+ * @param start The starting position of the range to be removed.
+ * @param length The length of the range, clamped to the end of the rope.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::remove(Size start, Size length)
+{
+    Size total = getLength();
+    if (start >= total || length == 0) return;
+
+    length = min(length, total - start);
+
+    if (length == total) {
+        destroyTree(root);
+        root = new Leaf();
+        return;
+    }
+
+    removeFrom(root, start, length);
+
+    while (!root->isLeaf && static_cast<Internal*>(root)->count == 1) { // Drop levels with a single child
+        Internal* oldRoot = static_cast<Internal*>(root);
+        root = oldRoot->children[0];
+        delete oldRoot;
+    }
+}
+
+/**
+ * Copies a range of characters of the rope into a new rope. This rope is left untouched.
+ *
+ * @param start The starting position of the range.
+ * @param length The length of the range.
+ *
+ * @return A new BTreeRope object containing the range.
+ *
+ * @throws None
+ */
+BTreeRope* BTreeRope::cut(Size start, Size length)
+{
+    Size total = getLength();
+    start = min(start, total);
+    length = min(length, total - start);
+
+    string text;
+    text.reserve(length);
+    copyText(root, start, length, text);
+
+    return new BTreeRope(text.data(), text.length());
+}
+
+/**
+ * Inserts the contents of the given rope `r` at the specified position `pos` in the current rope.
+ *
+ * @param pos The position at which the contents of `r` should be inserted.
+ * @param r The rope whose contents should be inserted.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::paste(Size pos, const BTreeRope* r)
+{
+    insert(pos, *r);
+}
+
+/**
+ * Appends the contents of a file to the rope, byte for byte.
+ *
+ * @param filename The name of the file to read.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::load(const char filename[])
+{
+    ifstream file(filename, ios::binary | ios::ate);
+
+    if (!file.is_open()) {
+        cout << "Error opening file" << endl;
+        return;
+    }
+
+    string text(size_t(file.tellg()), '\0');
+    file.seekg(0);
+    file.read(&text[0], text.length());
+    file.close();
+
+    append(text.data(), text.length());
+}
+
+/**
+ * Writes the contents of the rope to a file.
+ *
+ * @param filename The name of the file to write.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::save(const char filename[])
+{
+    ofstream file(filename, ios::binary);
+
+    if (!file.is_open()) {
+        std::cerr << "Error opening file" << std::endl;
+    }
+    else {
+        file << toString();
+        file.close();
+        cout << "Data has been written to : " << filename << endl;
+    }
+}
+
+/**
+ * Retrieves the length of the rope.
+ *
+ * @return The number of bytes in the rope.
+ */
+BTreeRope::Size BTreeRope::getLength() const
+{
+    return lengthOf(root);
+}
+
+/**
+ * Retrieves the height of the tree, 0 when the root is a leaf. Every leaf is at this depth.
+ *
+ * @return The number of internal levels.
+ */
+uint32_t BTreeRope::getHeight() const
+{
+    uint32_t height = 0;
+
+    for (const Node* node = root; !node->isLeaf; node = static_cast<const Internal*>(node)->children[0]) {
+        height++;
+    }
+
+    return height;
+}
+
+/*
+* BTREEROPE STATISTICS FUNCTIONS
+* ==============================
+* These functions walk the whole tree, they are meant for reports and tests.
+* - getLeafCount
+* - memoryOverhead
+*/
+
+/**
+ * Counts the leaves of the rope.
+ *
+ * @return The number of leaf nodes.
+ */
+uint32_t BTreeRope::getLeafCount() const
+{
+    uint32_t leaves = 0;
+
+    stack<const Node*> nodeStack;
+    nodeStack.push(root);
+
+    while (!nodeStack.empty()) {
+        const Node* currNode = nodeStack.top();
+        nodeStack.pop();
+
+        if (currNode->isLeaf) {
+            leaves++;
+            continue;
+        }
+
+        const Internal* inner = static_cast<const Internal*>(currNode);
+        for (uint32_t i = 0; i < inner->count; i++) {
+            nodeStack.push(inner->children[i]);
+        }
+    }
+
+    return leaves;
+}
+
+/**
+ * Computes how many bytes of bookkeeping the rope spends per byte of text.
+ * Node headers and the unused part of every leaf count as overhead.
+ *
+ * @return The overhead in bytes per byte of text, or 0 for an empty rope.
+ */
+double BTreeRope::memoryOverhead() const
+{
+    uint64_t textBytes = 0;
+    uint64_t totalBytes = 0;
+
+    stack<const Node*> nodeStack;
+    nodeStack.push(root);
+
+    while (!nodeStack.empty()) {
+        const Node* currNode = nodeStack.top();
+        nodeStack.pop();
+
+        if (currNode->isLeaf) {
+            textBytes += static_cast<const Leaf*>(currNode)->length;
+            totalBytes += sizeof(Leaf);
+            continue;
+        }
+
+        const Internal* inner = static_cast<const Internal*>(currNode);
+        totalBytes += sizeof(Internal);
+        for (uint32_t i = 0; i < inner->count; i++) {
+            nodeStack.push(inner->children[i]);
+        }
+    }
+
+    return textBytes ? double(totalBytes - textBytes) / double(textBytes) : 0.0;
+}
+
+/**
+ * Converts the rope to a string.
+ *
+ * @return The text of the rope.
+ */
+string BTreeRope::toString() const
+{
+    string text;
+    text.reserve(getLength());
+    copyText(root, 0, getLength(), text);
+    return text;
+}
+
+/**
+ * Prints the shape of the tree, one node per line indented by depth, leaves with their length.
+ *
+ * @param None
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void BTreeRope::printTree()
+{
+    cout << "Tree:- " << endl;
+
+    stack<pair<const Node*, uint32_t>> nodeStack;
+    nodeStack.push({root, 0});
+
+    while (!nodeStack.empty()) {
+        auto [currNode, depth] = nodeStack.top();
+        nodeStack.pop();
+
+        cout << string(depth * 4, ' ');
+
+        if (currNode->isLeaf) {
+            cout << "( w:" << lengthOf(currNode) << " )" << endl;
+            continue;
+        }
+
+        const Internal* inner = static_cast<const Internal*>(currNode);
+        cout << "[ w:" << lengthOf(currNode) << ", children:" << inner->count << " ]" << endl;
+
+        for (uint32_t i = inner->count; i > 0; i--) {
+            nodeStack.push({inner->children[i - 1], depth + 1});
+        }
+    }
+}
@@ -1,5 +1,6 @@
 #include <chrono>
 #include "rope.hpp"
+#include "btreeRope.hpp"
 #include "stringBuilder.hpp"
 #include <iostream>
 #include <cstring>
@@ -8,6 +9,7 @@
 #include <cassert>
 #include <chrono>
 #include <filesystem>
+#include <cmath>
 
 using namespace std;
 
@@ -287,6 +289,1105 @@ void test_paste() {
     cout << "--------------------------------" << endl << endl;
 }
 
+void test_substr() {
+    cout << "___________________________" << endl;
+    cout << "Testing substr()..." << endl;
+
+    string text;
+    for (int i = 0; i < 20000; i++) {
+        text += char('a' + (i * 7 + i / 13) % 26);
+    }
+
+    Rope rope(text.c_str(), text.length());
+    uint32_t leaves = rope.getLeafCount();
+
+    // Test ranges inside one leaf, across leaves, at both ends and past the end
+    const pair<uint32_t, uint32_t> ranges[] = {{0, 5}, {100, 3000}, {7777, 9000}, {19990, 10}, {19990, 100}, {0, 20000}, {5000, 0}, {30000, 5}};
+    for (auto [pos, len] : ranges) {
+        string expected = pos < text.length() ? text.substr(pos, len) : "";
+
+        Rope sub = rope.substr(pos, len);
+        assert(sub.toString() == expected);
+        assert(sub.getLength() == expected.length());
+
+        string copied(expected.length() + 1, '#');
+        assert(rope.copyTo(&copied[0], pos, len) == expected.length());
+        assert(copied.substr(0, expected.length()) == expected && copied.back() == '#');
+    }
+
+    // Test that the source is not modified and the slice is independent of it
+    assert(rope.toString() == text && rope.getLeafCount() == leaves);
+
+    Rope sub = rope.substr(2000, 10000);
+    sub.insert(10, "XYZ", 3);
+    sub.remove(500, 1000);
+    rope.remove(0, 3000);
+
+    string expected = text.substr(2000, 10000);
+    expected.insert(10, "XYZ");
+    expected.erase(500, 1000);
+    assert(sub.toString() == expected);
+    assert(rope.toString() == text.substr(3000));
+
+    cout << "Test substr passed successfully!" << endl;
+    cout << "--------------------------------" << endl << endl;
+}
+
+void test_arena() {
+    Rope rope("Hello World!", 12);
+
+    cout << "___________________________" << endl;
+    cout << "Testing arena()..." << endl;
+
+    // Test that edits recycle nodes without corrupting the text
+    for (int i = 0; i < 1000; i++) {
+        rope.insert(6, "big ", 4);
+        rope.remove(6, 4);
+    }
+    assert(rope.toString() == "Hello World!");
+
+    // Test that copies are not affected by later edits
+    Rope copy = rope;
+    rope.remove(0, 6);
+    assert(copy.toString() == "Hello World!");
+
+    copy = rope;
+    rope.append("?", 1);
+    assert(copy.toString() == "World!");
+    assert(rope.toString() == "World!?");
+
+    cout << "Test arena passed successfully!" << endl;
+    cout << "-------------------------------" << endl << endl;
+}
+
+void test_build() {
+    cout << "___________________________" << endl;
+    cout << "Testing build()..." << endl;
+
+    // Test that 1000 lines are built into a perfectly balanced tree
+    string text;
+    for (int i = 0; i < 1000; i++) {
+        text += "line " + to_string(i) + "\n";
+    }
+
+    Rope rope(text.c_str(), text.length());
+    assert(rope.toString() == text);
+    assert(rope.getHeight() == uint32_t(ceil(log2(rope.getLeafCount()))));
+
+    // Test that prepending several lines keeps their order
+    rope.prepend("a\nb\nc\n", 6);
+    assert(rope.toString() == "a\nb\nc\n" + text);
+
+    cout << "Test build passed successfully!" << endl;
+    cout << "-------------------------------" << endl << endl;
+}
+
+void test_leaf_policy() {
+    cout << "___________________________" << endl;
+    cout << "Testing leaf policy()..." << endl;
+
+    // Test that short lines are packed into leaves instead of one leaf per line
+    string text;
+    for (int i = 0; i < 5000; i++) {
+        text += "int x" + to_string(i % 10) + " = 0;\n"; // 13 byte lines
+    }
+
+    Rope rope(text.c_str(), text.length());
+    assert(rope.toString() == text);
+    assert(rope.getLeafCount() < text.length() / 256);
+
+    double overhead = rope.memoryOverhead();
+    cout << "Memory overhead: " << overhead << " bytes per byte of text" << endl;
+    assert(overhead < 0.5);
+
+    // Test that single character edits coalesce instead of piling up tiny leaves
+    uint32_t leaves = rope.getLeafCount();
+    for (int i = 0; i < 2000; i++) {
+        uint32_t pos = (i * 7919) % rope.getLength();
+        rope.insert(pos, "x", 1);
+        text.insert(pos, "x");
+        rope.remove((i * 104729) % rope.getLength(), 1);
+        text.erase((i * 104729) % text.length(), 1);
+    }
+    assert(rope.toString() == text);
+    assert(rope.getLeafCount() <= leaves * 2);
+
+    cout << "Memory overhead after edits: " << rope.memoryOverhead() << " bytes per byte of text" << endl;
+
+    // Test that two short leaves coalesced at a seam keep their text in the node
+    Rope seam("abgh", 4);
+    seam.insert(2, Rope("cdef", 4));
+    assert(seam.toString() == "abcdefgh");
+    assert(seam.getLeafCount() == 1 && seam.checkInvariants());
+    assert(seam.memoryOverhead() == double(Rope::getNodeSize() - 8) / 8);
+
+    cout << "Test leaf policy passed successfully!" << endl;
+    cout << "-------------------------------------" << endl << endl;
+}
+
+void test_slices() {
+    cout << "___________________________" << endl;
+    cout << "Testing slices()..." << endl;
+
+    // Test that splitting a leaf in the middle keeps both halves readable
+    string text(3000, 'a');
+    for (uint32_t i = 0; i < text.length(); i++) {
+        text[i] = 'a' + i % 26;
+    }
+
+    Rope rope(text.c_str(), text.length());
+    double overhead = rope.memoryOverhead();
+
+    string insert(300, '#'); // Well above the minimum leaf size, so it stays its own leaf
+    rope.insert(1500, insert.c_str(), insert.length());
+    text.insert(1500, insert);
+    assert(rope.toString() == text);
+
+    // The two halves share the original buffer, so no text was duplicated
+    assert(rope.memoryOverhead() < overhead + 0.1);
+
+    // Test that removing every slice of a buffer releases it
+    rope.remove(0, rope.getLength());
+    assert(rope.toString() == "");
+    assert(rope.getLength() == 0);
+
+    cout << "Test slices passed successfully!" << endl;
+    cout << "--------------------------------" << endl << endl;
+}
+
+void test_persistence() {
+    cout << "___________________________" << endl;
+    cout << "Testing persistence()..." << endl;
+
+    string text(5000, 'a');
+    for (uint32_t i = 0; i < text.length(); i++) {
+        text[i] = 'a' + i % 26;
+    }
+
+    // Test that a copy shares the whole tree instead of duplicating it
+    Rope rope(text.c_str(), text.length());
+    Rope copy = rope;
+    assert(copy.toString() == text);
+    assert(copy.memoryOverhead() == rope.memoryOverhead());
+
+    // Test an undo stack of snapshots taken while editing
+    vector<Rope> undo;
+    vector<string> expected;
+    for (int i = 0; i < 200; i++) {
+        undo.push_back(rope);
+        expected.push_back(text);
+
+        uint32_t pos = (i * 7919) % (text.length() + 1);
+        if (i % 3 == 2) {
+            rope.remove(pos, 40);
+            text.erase(pos, 40);
+        }
+        else {
+            rope.insert(pos, "edit", 4);
+            text.insert(pos, "edit");
+        }
+    }
+    assert(rope.toString() == text);
+
+    for (size_t i = 0; i < undo.size(); i++) {
+        assert(undo[i].toString() == expected[i]);
+    }
+
+    // Test that undoing back to a snapshot and editing it leaves the other versions alone
+    rope = undo[100];
+    rope.append(rope);
+    assert(rope.toString() == expected[100] + expected[100]);
+    assert(undo[100].toString() == expected[100]);
+
+    undo.clear();
+    rope.remove(0, expected[100].length());
+    assert(rope.toString() == expected[100]);
+    assert(copy.toString() == expected[0]);
+
+    cout << "Test persistence passed successfully!" << endl;
+    cout << "-------------------------------------" << endl << endl;
+}
+
+void test_lines() {
+    cout << "___________________________" << endl;
+    cout << "Testing lines()..." << endl;
+
+    // Test line lookups against a scan of the text, on a rope large enough to have many leaves
+    string text;
+    for (int i = 0; i < 2000; i++) {
+        text += "line " + to_string(i) + string(i % 13, '.') + (i % 7 == 0 ? "\n\n" : "\n");
+    }
+    text += "last";
+
+    Rope rope(text.c_str(), text.length());
+
+    vector<Rope::Size> starts = {0};
+    for (uint32_t i = 0; i < text.length(); i++) {
+        if (text[i] == '\n') {
+            starts.push_back(i + 1);
+        }
+    }
+
+    assert(rope.getLineCount() == starts.size());
+    for (uint32_t line = 0; line < starts.size(); line++) {
+        assert(rope.offsetOfLine(line) == starts[line]);
+    }
+    assert(rope.offsetOfLine(starts.size()) == text.length());
+
+    for (Rope::Size pos = 0, line = 0; pos <= text.length(); pos++) {
+        while (line + 1 < starts.size() && starts[line + 1] <= pos) {
+            line++;
+        }
+        assert(rope.lineOfOffset(pos) == line);
+        assert(rope.positionOfOffset(pos) == make_pair(line, pos - starts[line]));
+        assert(rope.offsetOfPosition(line, pos - starts[line]) == pos);
+    }
+
+    // Test that the counts follow edits
+    rope.insert(starts[10], "new\nlines\n", 10);
+    rope.remove(starts[500], starts[600] - starts[500]);
+    assert(rope.getLineCount() == starts.size() + 2 - 100);
+    assert(rope.offsetOfLine(12) == starts[10] + 10);
+
+    // Test columns past the end of a line and the line/column cut
+    Rope small("ab\ncdef\n\ngh", 11);
+    assert(small.offsetOfPosition(0, 10) == 2);
+    assert(small.offsetOfPosition(2, 3) == 8);
+    assert(small.offsetOfPosition(9, 0) == 11);
+    assert(small.cut(0, 1, 1, 2)->toString() == "b\ncd");
+    assert(small.cut(1, 0, 3, 1)->toString() == "cdef\n\ng");
+    assert(small.toString() == "ab\ncdef\n\ngh");
+
+    cout << "Test lines passed successfully!" << endl;
+    cout << "-------------------------------" << endl << endl;
+}
+
+void test_encoding() {
+    cout << "___________________________" << endl;
+    cout << "Testing encoding()..." << endl;
+
+    // Mix 1, 2, 3 and 4 byte characters, 4 byte ones take two UTF-16 units
+    const string samples[] = {"a", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\n"};
+    string text;
+    for (int i = 0; i < 5000; i++) {
+        text += samples[(i * 7 + i / 3) % 5];
+    }
+
+    Rope rope(text.c_str(), text.length());
+
+    // Reference positions of every character in all three units
+    vector<uint32_t> offsets, utf16;
+    uint32_t units = 0;
+    for (uint32_t i = 0; i < text.length(); i++) {
+        unsigned char c = text[i];
+        if ((c & 0xC0) == 0x80) { continue; }
+
+        offsets.push_back(i);
+        utf16.push_back(units);
+        units += c >= 0xF0 ? 2 : 1;
+    }
+
+    assert(rope.getCharCount() == offsets.size());
+    assert(rope.getUtf16Length() == units);
+
+    for (uint32_t c = 0; c < offsets.size(); c++) {
+        assert(rope.offsetOfChar(c) == offsets[c]);
+        assert(rope.charOfOffset(offsets[c]) == c);
+        assert(rope.offsetOfUtf16(utf16[c]) == offsets[c]);
+        assert(rope.utf16OfOffset(offsets[c]) == utf16[c]);
+        assert(rope.utf16OfChar(c) == utf16[c]);
+        assert(rope.charOfUtf16(utf16[c]) == c);
+    }
+    assert(rope.offsetOfChar(offsets.size()) == text.length());
+    assert(rope.offsetOfUtf16(units) == text.length());
+
+    // Test that the counts follow edits, positions coming from Qt are converted first
+    uint32_t pos = rope.offsetOfUtf16(utf16[1000]);
+    rope.insert(pos, "\xF0\x9F\x98\x80", 4);
+    rope.remove(rope.offsetOfChar(10), rope.offsetOfChar(20) - rope.offsetOfChar(10));
+    assert(rope.getCharCount() == offsets.size() + 1 - 10);
+    assert(rope.getUtf16Length() == units + 2 - (utf16[20] - utf16[10]));
+
+    cout << "Test encoding passed successfully!" << endl;
+    cout << "----------------------------------" << endl << endl;
+}
+
+void test_iterators() {
+    cout << "___________________________" << endl;
+    cout << "Testing iterators()..." << endl;
+
+    const string samples[] = {"ab", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\n"};
+    string text;
+    for (int i = 0; i < 3000; i++) {
+        text += samples[(i * 5 + i / 7) % 5];
+    }
+
+    Rope rope(text.c_str(), text.length());
+    Rope::Size needle = rope.offsetOfChar(600);
+    rope.insert(needle, "needle", 6);
+    text.insert(needle, "needle");
+
+    // Appending a rope to itself shares one subtree on both sides
+    rope.append(rope);
+    text += text;
+    assert(rope.getLeafCount() > 1);
+
+    // Test that the chunks cover the text in order, both ways
+    string joined;
+    uint32_t chunks = 0;
+    for (Rope::ChunkIterator it = rope.chunksBegin(); it != rope.chunksEnd(); ++it) {
+        assert((*it).size() > 0 && it.getOffset() == joined.size());
+        joined.append(*it);
+        chunks++;
+    }
+    assert(joined == text && chunks == rope.getLeafCount());
+
+    string reversed;
+    Rope::ChunkIterator chunk = rope.chunksEnd();
+    for (uint32_t i = 0; i < chunks; i++) {
+        --chunk;
+        reversed.insert(0, string(*chunk));
+    }
+    assert(reversed == text && chunk.getOffset() == 0);
+
+    // Test the byte iterator forwards, backwards and as a standard range
+    assert(string(rope.begin(), rope.end()) == text);
+
+    Rope::ByteIterator byte = rope.end();
+    for (size_t i = text.length(); i > 0; i--) {
+        --byte;
+        assert(*byte == text[i - 1] && byte.getPosition() == i - 1);
+    }
+
+    for (size_t pos = 0; pos < text.length(); pos += 97) {
+        assert(*rope.bytesAt(pos) == text[pos]);
+        assert(string(rope.bytesAt(pos), rope.bytesAt(pos + 50)) == text.substr(pos, 50));
+    }
+
+    // Test the code point iterator against a reference decoding
+    vector<pair<size_t, char32_t>> chars;
+    for (size_t i = 0; i < text.length(); i++) {
+        unsigned char c = text[i];
+        if ((c & 0xC0) == 0x80) { continue; }
+
+        int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+        char32_t code = extra ? c & (0x3F >> extra) : c;
+        for (int k = 1; k <= extra; k++) {
+            code = (code << 6) | (text[i + k] & 0x3F);
+        }
+        chars.push_back({i, code});
+    }
+
+    size_t index = 0;
+    for (Rope::CharIterator it = rope.charsBegin(); it != rope.charsEnd(); ++it, index++) {
+        assert(it.getPosition() == chars[index].first && *it == chars[index].second);
+    }
+    assert(index == chars.size() && index == rope.getCharCount());
+
+    Rope::CharIterator ch = rope.charsEnd();
+    for (size_t i = chars.size(); i > 0; i--) {
+        --ch;
+        assert(ch.getPosition() == chars[i - 1].first && *ch == chars[i - 1].second);
+    }
+    assert(*rope.charsAt(chars[100].first) == chars[100].second);
+
+    // Test searching across leaf boundaries
+    assert(rope.find("needle", 6) == needle);
+    assert(rope.find("needle", 6, needle + 1) == text.find("needle", needle + 1));
+    assert(rope.find("missing", 7) == Rope::npos);
+
+    // Test the empty rope
+    Rope empty;
+    assert(empty.begin() == empty.end() && empty.chunksBegin() == empty.chunksEnd());
+    assert(empty.toString() == "");
+
+    cout << "Test iterators passed successfully!" << endl;
+    cout << "-----------------------------------" << endl << endl;
+}
+
+void test_at() {
+    cout << "___________________________" << endl;
+    cout << "Testing at()..." << endl;
+
+    string text;
+    for (int i = 0; i < 20000; i++) {
+        text += char('a' + (i * 11 + i / 17) % 26);
+    }
+
+    Rope rope(text.c_str(), text.length());
+    assert(rope.getLeafCount() > 1);
+
+    // Test sequential reads both ways, they walk from leaf to leaf
+    for (uint32_t i = 0; i < text.length(); i++) {
+        assert(rope[i] == text[i]);
+    }
+    for (uint32_t i = text.length(); i > 0; i--) {
+        assert(rope.at(i - 1) == text[i - 1]);
+    }
+
+    // Test random reads
+    srand(7);
+    for (int i = 0; i < 5000; i++) {
+        uint32_t pos = rand() % text.length();
+        assert(rope[pos] == text[pos]);
+    }
+
+    // Test that reads after an edit do not use the old leaf
+    assert(rope[100] == text[100]);
+    rope.insert(50, "0123456789", 10);
+    text.insert(50, "0123456789");
+    assert(rope[100] == text[100] && rope[55] == '5');
+    rope.remove(0, 60);
+    text.erase(0, 60);
+    assert(rope[0] == text[0] && rope[100] == text[100]);
+
+    // Test that a copy keeps reading its own tree
+    Rope copy = rope;
+    assert(copy[200] == text[200]);
+    rope.remove(0, 1000);
+    assert(copy[201] == text[201] && rope[201] == text[1201]);
+
+    // Test the bounds check
+    bool thrown = false;
+    try {
+        rope.at(rope.getLength());
+    }
+    catch (const out_of_range&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    cout << "Test at passed successfully!" << endl;
+    cout << "----------------------------" << endl << endl;
+}
+
+void test_typing() {
+    cout << "___________________________" << endl;
+    cout << "Testing typing()..." << endl;
+
+    string text;
+    for (int i = 0; i < 300; i++) {
+        text += "line " + to_string(i) + "\n";
+    }
+
+    Rope rope(text.c_str(), text.length());
+    uint32_t height = rope.getHeight();
+
+    // Test a run of keystrokes and backspaces at a moving cursor
+    uint32_t cursor = 1000;
+    const string typed = "typing\nsome \xC3\xA9 text";
+    for (int round = 0; round < 20; round++) {
+        for (char c : typed) {
+            rope.insert(cursor, &c, 1);
+            text.insert(cursor, 1, c);
+            cursor++;
+        }
+        for (int i = 0; i < 5; i++) {
+            cursor--;
+            rope.remove(cursor);
+            text.erase(cursor, 1);
+        }
+    }
+    assert(rope.toString() == text);
+    assert(rope.getHeight() == height); // Edits inside the leaf do not reshape the tree
+    assert(rope.getLineCount() == uint32_t(count(text.begin(), text.end(), '\n')) + 1);
+    assert(rope.getCharCount() == text.length() - 20);
+
+    // Test that a copy made in the middle of typing keeps its text
+    Rope copy = rope;
+    string copyText = text;
+    rope.insert(cursor, "x", 1);
+    text.insert(cursor, "x");
+    rope.remove(cursor - 3, 2);
+    text.erase(cursor - 3, 2);
+    assert(copy.toString() == copyText);
+    assert(rope.toString() == text);
+
+    // Test typing past the end of the leaf and at the end of the rope
+    for (int i = 0; i < 3000; i++) {
+        rope.insert(cursor, "y", 1);
+        text.insert(cursor, "y");
+        cursor++;
+    }
+    rope.insert(rope.getLength(), "end", 3);
+    text += "end";
+    assert(rope.toString() == text);
+
+    cout << "Test typing passed successfully!" << endl;
+    cout << "--------------------------------" << endl << endl;
+}
+
+void test_balance() {
+    cout << "___________________________" << endl;
+    cout << "Testing balance()..." << endl;
+
+    // Random edits of every kind, checking the AVL and count invariants after each one
+    srand(17);
+    const string samples[] = {"line\n", "\xC3\xA9t\xC3\xA9 ", "\xF0\x9F\x98\x80", "word ", "\n\n"};
+    string text;
+    Rope rope;
+
+    auto randomText = [&](uint32_t maxLength) {
+        string str;
+        uint32_t length = rand() % maxLength;
+        while (str.length() < length) {
+            str += samples[rand() % 5];
+        }
+        return str;
+    };
+
+    for (int i = 0; i < 3000; i++) {
+        uint32_t pos = text.empty() ? 0 : rand() % (text.length() + 1);
+        uint32_t op = rand() % 8;
+
+        if (op < 3) {
+            string str = randomText(op == 0 ? 5000 : 20);
+            rope.insert(pos, str.c_str(), str.length());
+            text.insert(pos, str);
+        }
+        else if (op < 5) {
+            uint32_t len = rand() % (op == 3 ? 4000 : 5);
+            rope.remove(pos, len);
+            text.erase(min<size_t>(pos, text.length()), len);
+        }
+        else if (op == 5) {
+            string str = randomText(3000);
+            Rope other(str.c_str(), str.length());
+            rope.insert(pos, other);
+            text.insert(pos, str);
+        }
+        else if (op == 6) {
+            uint32_t len = rand() % 10000;
+            Rope slice = rope.substr(pos, len);
+            assert(slice.checkInvariants());
+            rope.append(slice);
+            text += text.substr(min<size_t>(pos, text.length()), len);
+        }
+        else if (text.length() > 200000) {
+            rope = rope.substr(pos / 2, 100000);
+            text = text.substr(pos / 2, 100000);
+        }
+
+        assert(rope.checkInvariants());
+        assert(rope.getLength() == text.length());
+
+        // An AVL tree of n leaves is at most 1.44 log2(n + 2) high
+        assert(rope.getHeight() <= 1.45 * log2(double(rope.getLeafCount()) + 2));
+    }
+    assert(rope.toString() == text);
+
+    // Test joining trees of very different heights both ways
+    string big(400000, 'b');
+    Rope tall(big.c_str(), big.length());
+    Rope small("s", 1);
+    Rope joined = small;
+    joined.append(tall);
+    joined.append(small);
+    joined.prepend(tall);
+    assert(joined.checkInvariants());
+    assert(joined.toString() == big + "s" + big + "s");
+
+    cout << "Test balance passed successfully!" << endl;
+    cout << "---------------------------------" << endl << endl;
+}
+
+void test_apply_edits() {
+    cout << "___________________________" << endl;
+    cout << "Testing applyEdits()..." << endl;
+
+    string text;
+    for (int i = 0; i < 2000; i++) {
+        text += "row " + to_string(i) + " of the table\n";
+    }
+    Rope rope(text.c_str(), text.length());
+
+    // Test random sorted batches against applying the same edits from the end of a string
+    srand(23);
+    const string inserts[] = {"", "x", "new text", string(3000, 'y')};
+    for (int round = 0; round < 50; round++) {
+        vector<Rope::Edit> edits;
+        Rope::Size pos = rand() % 100;
+        while (pos < text.length() && edits.size() < 40) {
+            Rope::Size removed = rand() % 3 == 0 ? 0 : rand() % 200;
+            edits.push_back({pos, removed, inserts[rand() % 4]});
+            pos += removed + rand() % 3000;
+        }
+
+        string expected = text;
+        for (auto edit = edits.rbegin(); edit != edits.rend(); ++edit) {
+            expected.replace(min<size_t>(edit->pos, expected.length()), edit->removed, edit->text);
+        }
+
+        rope.applyEdits(edits);
+        text = expected;
+        assert(rope.toString() == text);
+        assert(rope.checkInvariants());
+    }
+
+    // Test a replace-all built from find()
+    Rope table("one two one three one", 21);
+    vector<Rope::Edit> edits;
+    for (Rope::Size match = table.find("one", 3); match != Rope::npos; match = table.find("one", 3, match + 3)) {
+        edits.push_back({match, 3, "1"});
+    }
+    table.applyEdits(edits);
+    assert(table.toString() == "1 two 1 three 1");
+
+    // Test that overlapping edits are rejected before anything changes
+    bool thrown = false;
+    try {
+        table.applyEdits({{0, 5, "a"}, {3, 1, "b"}});
+    }
+    catch (const invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown && table.toString() == "1 two 1 three 1");
+
+    cout << "Test applyEdits passed successfully!" << endl;
+    cout << "------------------------------------" << endl << endl;
+}
+
+void test_log_append() {
+    cout << "___________________________" << endl;
+    cout << "Testing log append()..." << endl;
+
+    Rope rope;
+    string text;
+
+    // Test a log written one line at a time into an empty rope
+    Rope snapshot;
+    string snapshotText;
+    for (int i = 0; i < 20000; i++) {
+        string line = "entry " + to_string(i) + (i % 7 == 0 ? " caf\xC3\xA9" : "") + " status=" + to_string(i % 500) + "\n";
+        rope.append(line.c_str(), line.length());
+        text += line;
+
+        if (i == 5000) {
+            snapshot = rope;
+            snapshotText = text;
+        }
+    }
+    assert(rope.toString() == text);
+    assert(rope.checkInvariants());
+    assert(rope.getLineCount() == 20001);
+    assert(rope.getCharCount() == text.length() - (20000 + 6) / 7);
+    assert(rope.getLeafCount() < text.length() / 256); // Lines fill the tail leaf instead of getting one each
+
+    // Test that no leaf starts in the middle of a UTF-8 sequence
+    for (auto chunk = rope.chunksBegin(); chunk != rope.chunksEnd(); ++chunk) {
+        assert(((*chunk)[0] & 0xC0) != 0x80);
+    }
+
+    // Test that a copy made while appending keeps its text
+    assert(snapshot.toString() == snapshotText);
+
+    // Test appends mixed with edits and a block larger than a leaf
+    rope.insert(10, "edit", 4);
+    text.insert(10, "edit");
+    string block(10000, 'b');
+    rope.append(block.c_str(), block.length());
+    text += block;
+    rope.append("tail", 4);
+    text += "tail";
+    assert(rope.toString() == text);
+    assert(rope.checkInvariants());
+
+    cout << "Test log append passed successfully!" << endl;
+    cout << "------------------------------------" << endl << endl;
+}
+
+void test_reclaim() {
+    cout << "___________________________" << endl;
+    cout << "Testing reclaim()..." << endl;
+
+    string text;
+    for (int i = 0; text.length() < 1024 * 1024; i++) {
+        text += "line " + to_string(i) + " of a document being closed\n";
+    }
+
+    // Test handing ropes to the worker and waiting for their memory
+    for (int i = 0; i < 8; i++) {
+        Rope* rope = new Rope(text.c_str(), text.length());
+        rope->insert(i * 1000, "edit", 4);
+        Rope::reclaim(rope);
+    }
+    Rope::reclaim(nullptr);
+    Rope::waitForReclaim();
+
+    // Test that a copy sharing the arena outlives the reclaimed rope
+    Rope* rope = new Rope(text.c_str(), text.length());
+    Rope copy = *rope;
+    Rope::reclaim(rope);
+    copy.insert(10, "still here", 10);
+    text.insert(10, "still here");
+    assert(copy.toString() == text);
+    assert(copy.checkInvariants());
+    Rope::waitForReclaim();
+
+    cout << "Test reclaim passed successfully!" << endl;
+    cout << "---------------------------------" << endl << endl;
+}
+
+void test_inline_leaves() {
+    cout << "___________________________" << endl;
+    cout << "Testing inline leaves()..." << endl;
+
+    // Test that a short leaf costs its node and nothing else
+    Rope rope("Hello", 5);
+    assert(rope.toString() == "Hello");
+    assert(rope.memoryOverhead() == double(Rope::getNodeSize() - 5) / 5);
+
+    // Test typing into an empty rope, past the room in the node
+    Rope typed;
+    string text;
+    for (int i = 0; i < 40; i++) {
+        char c = char('a' + i % 26);
+        typed.insert(typed.getLength() / 2, &c, 1);
+        text.insert(text.length() / 2, 1, c);
+        assert(typed.toString() == text);
+    }
+    typed.remove(3, 30);
+    text.erase(3, 30);
+    assert(typed.toString() == text && typed.checkInvariants());
+
+    // Test that a copy keeps its text when the original edits an inline leaf
+    Rope copy = rope;
+    rope.insert(5, " World", 6);
+    rope.remove(0, 1);
+    assert(copy.toString() == "Hello");
+    assert(rope.toString() == "ello World");
+
+    // Test short slices of a long leaf
+    string line;
+    for (int i = 0; i < 100; i++) {
+        line += "word" + to_string(i) + " ";
+    }
+    Rope source(line.c_str(), line.length());
+    Rope slice = source.substr(50, 10);
+    assert(slice.toString() == line.substr(50, 10));
+    assert(slice.memoryOverhead() == double(Rope::getNodeSize() - 10) / 10);
+    assert(source.at(55) == line[55] && slice.at(5) == line[55]);
+
+    cout << "Test inline leaves passed successfully!" << endl;
+    cout << "---------------------------------------" << endl << endl;
+}
+
+void test_read_load() {
+    cout << "___________________________" << endl;
+    cout << "Testing read load()..." << endl;
+
+    string filename = (filesystem::temp_directory_path() / "rope_read.txt").string();
+
+    // Several load blocks of CRLF and LF lines, NUL bytes and UTF-8
+    string text;
+    for (int i = 0; text.length() < 2500000; i++) {
+        text += "line " + to_string(i) + (i % 3 == 0 ? string(" caf\xC3\xA9\0\r\n", 9) : "\n");
+    }
+    {
+        ofstream file(filename, ios::binary);
+        file.write(text.c_str(), text.length());
+    }
+
+    // Test that every byte is kept
+    Rope rope(filename.c_str());
+    assert(rope.getLength() == text.length());
+    assert(rope.toString() == text);
+    assert(rope.getLineCount() == Rope::Size(count(text.begin(), text.end(), '\n') + 1));
+    assert(rope.checkInvariants());
+
+    StringBuilder builder;
+    builder.load(filename);
+    assert(builder.toString() == text);
+
+    // Test loading at the end of a rope that already holds text
+    Rope appended("head\r\n", 6);
+    appended.load(filename.c_str());
+    assert(appended.toString() == "head\r\n" + text);
+    assert(appended.checkInvariants());
+
+    // Test that saving writes back the exact bytes, CRLF and lone CR included
+    string endings = string("crlf\r\nlone cr\rlf\nnul\0\r\r\n\n\r", 26);
+    {
+        ofstream file(filename, ios::binary | ios::trunc);
+        file.write(endings.c_str(), endings.length());
+    }
+    Rope roundTrip(filename.c_str());
+    assert(roundTrip.toString() == endings);
+    assert(roundTrip.save(filename.c_str()));
+    {
+        ifstream file(filename, ios::binary);
+        string saved((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        assert(saved == endings);
+    }
+
+    // Test a file ending right on a block boundary, and an empty file
+    text.resize(1 << 20);
+    {
+        ofstream file(filename, ios::binary | ios::trunc);
+        file.write(text.c_str(), text.length());
+    }
+    Rope block(filename.c_str());
+    assert(block.toString() == text);
+    assert(block.checkInvariants());
+
+    {
+        ofstream file(filename, ios::binary | ios::trunc);
+    }
+    Rope empty(filename.c_str());
+    assert(empty.getLength() == 0);
+    filesystem::remove(filename);
+
+    cout << "Test read load passed successfully!" << endl;
+    cout << "-------------------------------------" << endl << endl;
+}
+
+void test_mapped_load() {
+    cout << "___________________________" << endl;
+    cout << "Testing mapped load()..." << endl;
+
+    string filename = (filesystem::temp_directory_path() / "rope_mapped.txt").string();
+
+    string text;
+    for (int i = 0; i < 5000; i++) {
+        text += "line " + to_string(i) + (i % 3 == 0 ? " caf\xC3\xA9\r\n" : "\n");
+    }
+    {
+        ofstream file(filename, ios::binary);
+        file.write(text.c_str(), text.length());
+    }
+
+    // Test that the mapped rope holds every byte of the file
+    Rope rope(filename.c_str(), Rope::LoadMode::Map);
+    assert(rope.getLength() == text.length());
+    assert(rope.toString() == text);
+    assert(rope.getLineCount() == 5001);
+    assert(rope.checkInvariants());
+
+    // Test that edits go to the heap and leave the file alone
+    Rope snapshot = rope;
+    rope.insert(100, "inserted", 8);
+    text.insert(100, "inserted");
+    rope.remove(20000, 5000);
+    text.erase(20000, 5000);
+    rope.append("end\n", 4);
+    text += "end\n";
+    assert(rope.toString() == text);
+    assert(rope.substr(40000, 100).toString() == text.substr(40000, 100));
+
+    // Test saving over the mapped file while a copy still views it
+    string original = snapshot.toString();
+    assert(rope.save(filename.c_str()));
+    assert(snapshot.toString() == original);
+    assert(rope.toString() == text);
+    assert(!filesystem::exists(filename + ".tmp"));
+
+    Rope reloaded(filename.c_str(), Rope::LoadMode::Map);
+    assert(reloaded.toString() == text);
+
+    // Test that a failed replace reports it, keeps the target and removes the temporary file
+    filesystem::remove(filename);
+    filesystem::create_directory(filename);
+    ofstream(filename + "/inside.txt") << "keeps the directory from being replaced";
+    assert(!reloaded.save(filename.c_str()));
+    assert(filesystem::is_directory(filename));
+    assert(!filesystem::exists(filename + ".tmp"));
+    assert(reloaded.toString() == text);
+    filesystem::remove_all(filename);
+    assert(!rope.save((filename + "/missing/rope.txt").c_str()));
+
+    // Test an empty and a missing file
+    {
+        ofstream file(filename, ios::binary | ios::trunc);
+    }
+    Rope empty(filename.c_str(), Rope::LoadMode::Map);
+    assert(empty.getLength() == 0);
+    filesystem::remove(filename);
+
+    cout << "Test mapped load passed successfully!" << endl;
+    cout << "-------------------------------------" << endl << endl;
+}
+
+void test_lazy_load() {
+    cout << "___________________________" << endl;
+    cout << "Testing lazy load()..." << endl;
+
+    string filename = (filesystem::temp_directory_path() / "rope_lazy.txt").string();
+    const size_t page = 1 << 16;
+
+    // About 5.5 pages, with multi-byte characters cut by the page boundaries
+    string text;
+    for (int i = 0; text.length() < 5 * page + page / 2; i++) {
+        text += "line " + to_string(i) + (i % 3 == 0 ? " caf\xC3\xA9 \xF0\x9F\x98\x80\r\n" : "\n");
+    }
+    {
+        ofstream file(filename, ios::binary);
+        file.write(text.c_str(), text.length());
+    }
+    Rope expected(text.c_str(), text.length());
+
+    // Test that opening reads nothing and reading the end reads the last page alone
+    Rope rope(filename.c_str(), Rope::LoadMode::Lazy);
+    assert(rope.getLength() == text.length());
+    assert(rope.getResidentBytes() == 0);
+    assert(rope[text.length() - 1] == text.back());
+    assert(rope.substr(text.length() - 100, 100).toString() == text.substr(text.length() - 100));
+    assert(rope.getResidentBytes() == text.length() % page);
+
+    // Test that a line query only reads the pages up to its position
+    assert(rope.lineOfOffset(1000) == expected.lineOfOffset(1000));
+    assert(rope.getResidentBytes() == page + text.length() % page);
+    assert(rope.lineOfOffset(3 * page + 10) == expected.lineOfOffset(3 * page + 10));
+    assert(rope.getResidentBytes() == 4 * page + text.length() % page);
+
+    // Test that going to an early line or UTF-16 position only reads the first page
+    Rope early(filename.c_str(), Rope::LoadMode::Lazy);
+    assert(early.offsetOfLine(10) == expected.offsetOfLine(10));
+    assert(early.offsetOfUtf16(100) == expected.offsetOfUtf16(100));
+    assert(early.offsetOfPosition(10, 3) == expected.offsetOfPosition(10, 3));
+    assert(early.getResidentBytes() == page);
+    assert(early.offsetOfLine(expected.getLineCount()) == expected.getLength());
+    assert(early.offsetOfChar(expected.getCharCount()) == expected.getLength());
+    assert(early.offsetOfPosition(expected.getLineCount() - 1, 5) == expected.offsetOfPosition(expected.getLineCount() - 1, 5));
+    assert(early.checkInvariants());
+
+    // Test that a scan stays within the budget and the evicted pages read back the same
+    rope.setPageBudget(2 * page);
+    assert(rope.getResidentBytes() <= 2 * page);
+    assert(rope.toString() == text);
+    assert(rope.getResidentBytes() <= 2 * page);
+    assert(rope.find("line 2000", 9) == text.find("line 2000"));
+
+    // Test that the counts match a rope built in memory
+    assert(rope.getLineCount() == expected.getLineCount());
+    assert(rope.getCharCount() == expected.getCharCount());
+    assert(rope.getUtf16Length() == expected.getUtf16Length());
+    assert(rope.offsetOfLine(3000) == expected.offsetOfLine(3000));
+    assert(rope.offsetOfUtf16(200000) == expected.offsetOfUtf16(200000));
+    assert(rope.checkInvariants());
+
+    // Test edits on a fresh lazy rope, across page boundaries, and a copy sharing its pages
+    Rope edited(filename.c_str(), Rope::LoadMode::Lazy);
+    Rope snapshot = edited;
+    edited.insert(page + 10, "inserted", 8);
+    text.insert(page + 10, "inserted");
+    edited.remove(2 * page - 100, 300);
+    text.erase(2 * page - 100, 300);
+    edited.append("end\n", 4);
+    text += "end\n";
+    assert(edited.checkInvariants());
+    assert(edited.toString() == text);
+    assert(edited.getLineCount() == Rope(text.c_str(), text.length()).getLineCount());
+    assert(snapshot.getLength() == expected.getLength());
+
+    // Test saving over the file while a copy still pages it in
+    assert(edited.save(filename.c_str()));
+    assert(snapshot.toString() == expected.toString());
+    Rope reloaded(filename.c_str(), Rope::LoadMode::Lazy);
+    assert(reloaded.toString() == text);
+    filesystem::remove(filename);
+
+    cout << "Test lazy load passed successfully!" << endl;
+    cout << "-------------------------------------" << endl << endl;
+}
+
+void test_large_sizes() {
+    cout << "___________________________" << endl;
+    cout << "Testing large sizes()..." << endl;
+
+    if (sizeof(Rope::Size) < sizeof(uint64_t)) {
+        cout << "Skipped, build with ROPE_64BIT to test ropes over 4GB" << endl << endl;
+        return;
+    }
+
+    // Doubling a rope shares both halves, so an 8GB rope only needs a few KB of nodes
+    string block;
+    for (int i = 0; block.length() < 1000; i++) {
+        block += "line " + to_string(i) + "\n";
+    }
+    block.resize(1000);
+    Rope::Size blockLines = count(block.begin(), block.end(), '\n');
+
+    Rope rope(block.c_str(), block.length());
+    for (int i = 0; i < 23; i++) {
+        rope.append(rope);
+    }
+    assert(rope.getLength() == Rope::Size(1000) << 23);
+    assert(rope.getLineCount() == (blockLines << 23) + 1);
+
+    // Test editing past the 4GB mark
+    Rope::Size pos = rope.getLength() / 8 * 5 + 123;
+    Rope::Size line = pos / 1000 * blockLines + count(block.begin(), block.begin() + pos % 1000, '\n');
+
+    rope.insert(pos, "here", 4);
+    assert(rope.getLength() == (Rope::Size(1000) << 23) + 4);
+    assert(rope.lineOfOffset(pos) == line);
+
+    Rope* piece = rope.cut(pos - 3, 10);
+    assert(piece->toString() == block.substr(120, 3) + "here" + block.substr(123, 3));
+    delete piece;
+
+    rope.remove(pos, 4);
+    assert(rope.getLength() == Rope::Size(1000) << 23);
+
+    cout << "Test large sizes passed successfully!" << endl;
+    cout << "-------------------------------------" << endl << endl;
+}
+
+void test_btree() {
+    cout << "___________________________" << endl;
+    cout << "Testing btree()..." << endl;
+
+    BTreeRope rope("Hello World!", 12);
+    rope.insert(6, "big ", 4);
+    rope.append(" Bye", 4);
+    rope.prepend(">", 1);
+    rope.remove(0, 1);
+    assert(rope.toString() == "Hello big World! Bye");
+
+    BTreeRope* cutRope = rope.cut(6, 3);
+    assert(cutRope->toString() == "big");
+    assert(rope.toString() == "Hello big World! Bye");
+    delete cutRope;
+
+    // Test random edits against a plain string, with inserts large enough to split nodes
+    // and removals large enough to merge them
+    string text = rope.toString();
+    srand(42);
+    for (int i = 0; i < 3000; i++) {
+        int kind = rand() % 4;
+        string chunk(rand() % (i % 50 == 0 ? 20000 : 300) + 1, char('a' + i % 26));
+
+        if (kind < 3 || text.empty()) {
+            uint32_t pos = rand() % (text.length() + 1);
+            rope.insert(pos, chunk.c_str(), chunk.length());
+            text.insert(pos, chunk);
+        }
+        else {
+            uint32_t pos = rand() % text.length();
+            uint32_t len = rand() % (i % 20 == 0 ? 50000 : 500) + 1;
+            rope.remove(pos, len);
+            text.erase(pos, len);
+        }
+        assert(rope.getLength() == text.length());
+    }
+    assert(rope.toString() == text);
+
+    // Every internal node holds at least 8 children, so the tree stays shallow
+    uint32_t height = 0;
+    for (uint32_t leaves = rope.getLeafCount(); leaves > 1; leaves = (leaves + 7) / 8) {
+        height++;
+    }
+    assert(rope.getHeight() <= height);
+
+    BTreeRope copy = rope;
+    rope.remove(0, rope.getLength());
+    assert(rope.toString() == "");
+    assert(copy.toString() == text);
+
+    cout << "Test btree passed successfully!" << endl;
+    cout << "-------------------------------" << endl << endl;
+}
+
 void run_tests() {
     cout << "*****************************************" << endl;
     cout << "Running Rope tests... " << endl;
@@ -298,6 +1399,27 @@ void run_tests() {
     test_remove();
     test_cut();
     test_paste();
+    test_substr();
+    test_arena();
+    test_build();
+    test_leaf_policy();
+    test_slices();
+    test_persistence();
+    test_lines();
+    test_encoding();
+    test_iterators();
+    test_at();
+    test_typing();
+    test_balance();
+    test_apply_edits();
+    test_log_append();
+    test_reclaim();
+    test_inline_leaves();
+    test_read_load();
+    test_mapped_load();
+    test_lazy_load();
+    test_large_sizes();
+    test_btree();
 
     cout << "All tests passed!" << endl;
     cout << "*****************************************" << endl << endl;
@@ -380,8 +1502,13 @@ void benchmark(const string files[], const int num_files) {
     for (int i = 0; i < num_files; i++) {
         string file = files[i];
         
-        ifstream f (file);
-        uint32_t totalSizeKB = f.seekg(0, ios::end).tellg() / 1024;
+        ifstream f (file, ios::binary);
+        if (!f.is_open()) {
+            cout << "Error opening file " << file << endl;
+            continue;
+        }
+        uint64_t totalSizeBytes = f.seekg(0, ios::end).tellg();
+        uint32_t totalSizeKB = totalSizeBytes / 1024;
 
         cout << "*********************************************************************************************************************************************" << endl;
         cout << "File: " << file << " of size (" << totalSizeKB << "KB) "<< endl << endl;
@@ -393,15 +1520,20 @@ void benchmark(const string files[], const int num_files) {
         sb.load(file);
         auto stop = chrono::high_resolution_clock::now();
         auto duration = chrono::duration_cast<chrono::nanoseconds>(stop - start);
-        cout << "Loading benchmark done for file" << file << " StringBuilder took " << duration.count() << " nanoseconds." << endl;
+        cout << "Loading benchmark done for file" << file << " StringBuilder took " << duration.count() << " nanoseconds ("
+             << double(totalSizeBytes) / duration.count() << " GB/s)." << endl; // Bytes per nanosecond
 
         start = chrono::high_resolution_clock::now();
         Rope* rope = new Rope(file.c_str());
         stop = chrono::high_resolution_clock::now();
         duration = chrono::duration_cast<chrono::nanoseconds>(stop - start);
-        cout << "Loading benchmark done for file" << file << " of size (" << totalSizeKB << "KB) Rope took " << duration.count() << " nanoseconds." << endl;
+        cout << "Loading benchmark done for file" << file << " of size (" << totalSizeKB << "KB) Rope took " << duration.count() << " nanoseconds ("
+             << double(totalSizeBytes) / duration.count() << " GB/s)." << endl;
+        cout << "Rope memory overhead: " << rope->memoryOverhead() << " bytes per byte of text over " << rope->getLeafCount() << " leaves." << endl;
+        cout << "Rope nodes: " << Rope::getNodeSize() << " bytes each, " << (2 * rope->getLeafCount() - 1) * Rope::getNodeSize() / 1024 << "KB in total." << endl;
 
         cout << "Testing equality...";
+        assert(sb.toString().length() == totalSizeBytes); // Every byte of the file, newlines included
         assert(sb.toString() == rope->toString());
         cout << "Passed!" << endl;
 
@@ -504,6 +1636,518 @@ void benchmark(const string files[], const int num_files) {
 
 }
 
+string generateText(uint32_t sizeBytes)
+{
+    string words [] = {"Lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+             "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore"};
+    int length = sizeof(words) / sizeof(words[0]);
+
+    string text;
+    text.reserve(sizeBytes);
+
+    uint32_t lineLength = 0;
+    while (text.size() < sizeBytes) {
+        text += words[rand() % length];
+        lineLength += 1;
+        text += (lineLength % 12 == 0) ? '\n' : ' ';
+    }
+    text.resize(sizeBytes);
+
+    return text;
+}
+
+template <class RopeType>
+void runTreeWorkload(RopeType& rope, const vector<Blocks>& appends, const vector<Blocks>& inserts,
+                     const vector<pair<uint32_t,uint32_t>>& removals, long long durations[3])
+{
+    auto start = chrono::high_resolution_clock::now();
+    for (const Blocks& block : appends) {
+        rope.append(block.text.c_str(), block.text.length());
+    }
+    auto stop = chrono::high_resolution_clock::now();
+    durations[0] = chrono::duration_cast<chrono::nanoseconds>(stop - start).count();
+
+    start = chrono::high_resolution_clock::now();
+    for (const Blocks& block : inserts) {
+        rope.insert(block.pos, block.text.c_str(), block.text.length());
+    }
+    stop = chrono::high_resolution_clock::now();
+    durations[1] = chrono::duration_cast<chrono::nanoseconds>(stop - start).count();
+
+    start = chrono::high_resolution_clock::now();
+    for (auto pos : removals) {
+        rope.remove(pos.first, pos.second - pos.first);
+    }
+    stop = chrono::high_resolution_clock::now();
+    durations[2] = chrono::duration_cast<chrono::nanoseconds>(stop - start).count();
+}
+
+void benchmarkTrees(const string files[], const int num_files) {
+
+    cout << "_____________________________________________________________________________________________________________________________________________" << endl;
+    cout << "Binary Tree vs B+-Tree Benchmark for " << num_files << " file(s)..." << endl;
+
+    for (int i = 0; i < num_files; i++) {
+        ifstream f (files[i], ios::binary);
+        string text((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+        uint32_t totalSizeKB = max<uint32_t>(text.length() / 1024, 1);
+
+        // Both trees replay the same append/insert/remove workload as benchmark()
+        int num_blocks = 30;
+        vector<Blocks> appends = generateRandomBlocks(totalSizeKB*num_blocks, totalSizeKB, text.length() + 1);
+        uint32_t length = text.length();
+        for (const Blocks& block : appends) {
+            length += block.text.length();
+        }
+        vector<Blocks> inserts = generateRandomBlocks(totalSizeKB*num_blocks, totalSizeKB, length + 1);
+        for (const Blocks& block : inserts) {
+            length += block.text.length();
+        }
+        vector<pair<uint32_t,uint32_t>> removals = generateRemovalPos(totalSizeKB*num_blocks, totalSizeKB, length);
+
+        long long ropeTimes[3], btreeTimes[3];
+
+        Rope rope(text.c_str(), text.length());
+        runTreeWorkload(rope, appends, inserts, removals, ropeTimes);
+
+        BTreeRope btree(text.c_str(), text.length());
+        runTreeWorkload(btree, appends, inserts, removals, btreeTimes);
+
+        cout << "File: " << files[i] << " of size (" << totalSizeKB << "KB)" << endl;
+        cout << "Appending:- Rope took " << ropeTimes[0] << " ns, BTreeRope took " << btreeTimes[0] << " ns." << endl;
+        cout << "Insertion:- Rope took " << ropeTimes[1] << " ns, BTreeRope took " << btreeTimes[1] << " ns." << endl;
+        cout << "Removal:-   Rope took " << ropeTimes[2] << " ns, BTreeRope took " << btreeTimes[2] << " ns." << endl;
+        cout << "Height:- Rope " << rope.getHeight() << ", BTreeRope " << btree.getHeight()
+             << ". Memory overhead:- Rope " << rope.memoryOverhead() << ", BTreeRope " << btree.memoryOverhead() << endl;
+
+        cout << "Testing equality...";
+        assert(rope.toString() == btree.toString());
+        cout << "Passed!" << endl << endl;
+    }
+
+    cout << "----------------------------------------------------------------------------------------------------------------------------------------------" << endl;
+}
+
+void benchmarkInsertScaling(uint32_t maxSizeMB) {
+
+    cout << "_____________________________________________________________________________________________________________________________________________" << endl;
+    cout << "Insert Scaling Benchmark:- up to " << maxSizeMB << "MB..." << endl;
+
+    const uint32_t blockSize = 1024 * 1024;
+    const int num_inserts = 10000;
+
+    string block = generateText(blockSize);
+    Rope rope;
+    uint32_t sizeMB = 0;
+
+    srand(time(0));
+
+    for (uint32_t targetMB = 1; targetMB <= maxSizeMB; targetMB *= 2) {
+        while (sizeMB < targetMB) {
+            rope.append(block.c_str(), block.length());
+            sizeMB++;
+        }
+
+        auto start = chrono::high_resolution_clock::now();
+        for (int i = 0; i < num_inserts; i++) {
+            uint32_t pos = ((uint32_t(rand()) << 15) ^ uint32_t(rand())) % rope.getLength();
+            rope.insert(pos, "x", 1);
+        }
+        auto stop = chrono::high_resolution_clock::now();
+        auto duration = chrono::duration_cast<chrono::nanoseconds>(stop - start);
+
+        double perInsert = double(duration.count()) / num_inserts;
+        cout << "Rope of " << sizeMB << "MB: " << perInsert << " ns per insert, "
+             << perInsert / log2(double(rope.getLength())) << " ns per insert / log2(n)" << endl;
+    }
+
+    cout << "----------------------------------------------------------------------------------------------------------------------------------------------" << endl;
+}
+
+void benchmarkAccess(uint32_t sizeMB) {
+
+    cout << "_____________________________________________________________________________________________________________________________________________" << endl;
+    cout << "Indexed Access Benchmark:- " << sizeMB << "MB..." << endl;
+
+    const int num_reads = 1000000;
+
+    string text = generateText(sizeMB * 1024 * 1024);
+    Rope rope(text.c_str(), text.length());
+
+    srand(time(0));
+    vector<uint32_t> positions(num_reads);
+    for (int i = 0; i < num_reads; i++) {
+        positions[i] = ((uint32_t(rand()) << 15) ^ uint32_t(rand())) % rope.getLength();
+    }
+
+    // Random reads descend from the root, sequential and nearby reads stay in the cached leaf
+    uint32_t checksum = 0;
+    auto start = chrono::high_resolution_clock::now();
+    for (uint32_t pos : positions) {
+        checksum += rope[pos];
+    }
+    auto stop = chrono::high_resolution_clock::now();
+    double randomNs = double(chrono::duration_cast<chrono::nanoseconds>(stop - start).count()) / num_reads;
+
+    start = chrono::high_resolution_clock::now();
+    for (int i = 0; i < num_reads; i++) {
+        checksum += rope[i % rope.getLength()];
+    }
+    stop = chrono::high_resolution_clock::now();
+    double sequentialNs = double(chrono::duration_cast<chrono::nanoseconds>(stop - start).count()) / num_reads;
+
+    start = chrono::high_resolution_clock::now();
+    for (int i = 0; i < num_reads; i++) {
+        checksum += rope[(positions[i % 1000] + i % 64) % rope.getLength()]; // Cursor jumping around a few spots
+    }
+    stop = chrono::high_resolution_clock::now();
+    double nearbyNs = double(chrono::duration_cast<chrono::nanoseconds>(stop - start).count()) / num_reads;
+
+    cout << "Random reads: " << randomNs << " ns per read" << endl;
+    cout << "Sequential reads: " << sequentialNs << " ns per read" << endl;
+    cout << "Clustered reads: " << nearbyNs << " ns per read" << endl;
+    cout << "(checksum " << checksum << ")" << endl;
+
+    cout << "----------------------------------------------------------------------------------------------------------------------------------------------" << endl;
+}
+
+void benchmarkKeystrokes(uint32_t sizeMB) {
+
+    cout << "_____________________________________________________________________________________________________________________________________________" << endl;
+    cout << "Keystroke Replay Benchmark:- " << sizeMB << "MB..." << endl;
+
+    const int num_keystrokes = 1000000;
+
+    string text = generateText(sizeMB * 1024 * 1024);
+    Rope rope(text.c_str(), text.length());
+
+    // Typing session: mostly characters at the cursor, some backspaces, and now and then
+    // a click somewhere else in the file
+    struct Keystroke {
+        uint32_t pos;
+        char c; // 0 for a backspace
+    };
+
+    srand(time(0));
+    vector<Keystroke> keystrokes;
+    uint32_t length = rope.getLength();
+    uint32_t cursor = length / 2;
+    for (int i = 0; i < num_keystrokes; i++) {
+        if (rand() % 200 == 0) {
+            cursor = ((uint32_t(rand()) << 15) ^ uint32_t(rand())) % length;
+        }
+
+        if (rand() % 5 == 0 && cursor > 0) {
+            keystrokes.push_back({--cursor, 0});
+            length--;
+        }
+        else {
+            keystrokes.push_back({cursor++, char('a' + rand() % 26)});
+            length++;
+        }
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+    for (const Keystroke& key : keystrokes) {
+        if (key.c == 0) {
+            rope.remove(key.pos);
+        }
+        else {
+            rope.insert(key.pos, &key.c, 1);
+        }
+    }
+    auto stop = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::nanoseconds>(stop - start);
+
+    cout << "Replayed " << num_keystrokes << " keystrokes in " << duration.count() / 1000000 << " ms, "
+         << double(duration.count()) / num_keystrokes << " ns per keystroke" << endl;
+    cout << "Final length: " << rope.getLength() << " (expected " << length << "), height: " << rope.getHeight() << endl;
+
+    cout << "----------------------------------------------------------------------------------------------------------------------------------------------" << endl;
+}
+
+void benchmarkPaste(uint32_t sizeMB, uint32_t pasteMB) {
+
+    cout << "_____________________________________________________________________________________________________________________________________________" << endl;
+    cout << "Paste Benchmark:- " << pasteMB << "MB blocks into " << sizeMB << "MB..." << endl;
+
+    const int num_pastes = 10;
+
+    string text = generateText(sizeMB * 1024 * 1024);
+    string block = generateText(pasteMB * 1024 * 1024);
+    Rope rope(text.c_str(), text.length());
+
+    srand(time(0));
+
+    auto start = chrono::high_resolution_clock::now();
+    for (int i = 0; i < num_pastes; i++) {
+        uint32_t pos = ((uint32_t(rand()) << 15) ^ uint32_t(rand())) % rope.getLength();
+        rope.insert(pos, block.c_str(), block.length());
+    }
+    auto stop = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::microseconds>(stop - start);
+
+    cout << double(duration.count()) / num_pastes / 1000 << " ms per paste, "
+         << double(duration.count()) / num_pastes / pasteMB << " us per pasted MB" << endl;
+    cout << "Final length: " << rope.getLength() << ", height: " << rope.getHeight() << ", leaves: " << rope.getLeafCount() << endl;
+
+    cout << "----------------------------------------------------------------------------------------------------------------------------------------------" << endl;
+}
+
+void benchmarkReplaceAll(uint32_t sizeMB) {
+
+    cout << "_____________________________________________________________________________________________________________________________________________" << endl;
+    cout << "Replace All Benchmark:- " << sizeMB << "MB..." << endl;
+
+    string text = generateText(sizeMB * 1024 * 1024);
+    Rope rope(text.c_str(), text.length());
+
+    // Every 1000th word becomes a replacement, the way a search and replace-all would
+    vector<Rope::Edit> edits;
+    for (Rope::Size pos = 0; pos + 5 < rope.getLength(); pos += 997) {
+        edits.push_back({pos, 5, "REPLACED"});
+    }
+
+    Rope batch = rope;
+    auto start = chrono::high_resolution_clock::now();
+    batch.applyEdits(edits);
+    auto stop = chrono::high_resolution_clock::now();
+    auto batchDuration = chrono::duration_cast<chrono::microseconds>(stop - start);
+
+    // The same edits one at a time, from the end so the positions stay valid
+    Rope single = rope;
+    start = chrono::high_resolution_clock::now();
+    for (auto edit = edits.rbegin(); edit != edits.rend(); ++edit) {
+        single.remove(edit->pos, edit->removed);
+        single.insert(edit->pos, edit->text.data(), edit->text.size());
+    }
+    stop = chrono::high_resolution_clock::now();
+    auto singleDuration = chrono::duration_cast<chrono::microseconds>(stop - start);
+
+    cout << edits.size() << " replacements" << endl;
+    cout << "applyEdits: " << batchDuration.count() / 1000.0 << " ms" << endl;
+    cout << "remove + insert: " << singleDuration.count() / 1000.0 << " ms" << endl;
+    cout << "Same result: " << (batch.getLength() == single.getLength() && batch.toString() == single.toString() ? "yes" : "no") << endl;
+
+    cout << "----------------------------------------------------------------------------------------------------------------------------------------------" << endl;
+}
+
+void benchmarkLogAppend(uint32_t sizeMB) {
+
+    cout << "_____________________________________________________________________________________________________________________________________________" << endl;
+    cout << "Log Append Benchmark:- " << sizeMB << "MB..." << endl;
+
+    // A log written one line at a time, starting from an empty rope
+    string text = generateText(sizeMB * 1024 * 1024);
+    vector<pair<uint32_t, uint32_t>> lines;
+    for (uint32_t start = 0; start < text.length();) {
+        size_t newline = text.find('\n', start);
+        uint32_t end = newline == string::npos ? uint32_t(text.length()) : uint32_t(newline) + 1;
+        lines.push_back({start, end - start});
+        start = end;
+    }
+
+    Rope rope;
+    BTreeRope btree;
+    const size_t quarter = lines.size() / 4 + 1;
+
+    for (size_t i = 0; i < lines.size(); i += quarter) {
+        size_t last = min(lines.size(), i + quarter);
+
+        auto start = chrono::high_resolution_clock::now();
+        for (size_t j = i; j < last; j++) {
+            rope.append(text.c_str() + lines[j].first, lines[j].second);
+        }
+        auto stop = chrono::high_resolution_clock::now();
+        auto ropeDuration = chrono::duration_cast<chrono::nanoseconds>(stop - start);
+
+        start = chrono::high_resolution_clock::now();
+        for (size_t j = i; j < last; j++) {
+            btree.append(text.c_str() + lines[j].first, lines[j].second);
+        }
+        stop = chrono::high_resolution_clock::now();
+        auto btreeDuration = chrono::duration_cast<chrono::nanoseconds>(stop - start);
+
+        cout << "Up to " << rope.getLength() / (1024 * 1024) << "MB: Rope " << double(ropeDuration.count()) / (last - i)
+             << " ns, B+-Tree " << double(btreeDuration.count()) / (last - i) << " ns per line" << endl;
+    }
+
+    cout << lines.size() << " lines, leaves: " << rope.getLeafCount() << ", height: " << rope.getHeight()
+         << ", overhead: " << rope.memoryOverhead() * 100 << "%" << endl;
+    cout << "Same text: " << (rope.toString() == text && btree.toString() == text ? "yes" : "no") << endl;
+
+    cout << "----------------------------------------------------------------------------------------------------------------------------------------------" << endl;
+}
+
+void benchmarkClose(uint32_t sizeMB) {
+
+    cout << "_____________________________________________________________________________________________________________________________________________" << endl;
+    cout << "Close Benchmark:- " << sizeMB << "MB..." << endl;
+
+    string text = generateText(sizeMB * 1024 * 1024);
+
+    // Closing a document on the UI thread, with and without the worker
+    Rope* rope = new Rope(text.c_str(), text.length());
+    auto start = chrono::high_resolution_clock::now();
+    delete rope;
+    auto stop = chrono::high_resolution_clock::now();
+    auto deleteDuration = chrono::duration_cast<chrono::microseconds>(stop - start);
+
+    rope = new Rope(text.c_str(), text.length());
+    start = chrono::high_resolution_clock::now();
+    Rope::reclaim(rope);
+    stop = chrono::high_resolution_clock::now();
+    auto reclaimDuration = chrono::duration_cast<chrono::microseconds>(stop - start);
+
+    Rope::waitForReclaim();
+    auto freed = chrono::high_resolution_clock::now();
+    auto workerDuration = chrono::duration_cast<chrono::microseconds>(freed - start);
+
+    cout << "delete: " << deleteDuration.count() / 1000.0 << " ms" << endl;
+    cout << "reclaim: " << reclaimDuration.count() / 1000.0 << " ms, memory released after "
+         << workerDuration.count() / 1000.0 << " ms" << endl;
+
+    cout << "----------------------------------------------------------------------------------------------------------------------------------------------" << endl;
+}
+
+void benchmarkSmallLeaves(uint32_t count) {
+
+    cout << "_____________________________________________________________________________________________________________________________________________" << endl;
+    cout << "Small Leaves Benchmark:- " << count << " words..." << endl;
+
+    // Words added at the front, one leaf each, then read back
+    Rope rope;
+    auto start = chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < count; i++) {
+        string word = "w" + to_string(i) + " ";
+        rope.prepend(word.c_str(), word.length());
+    }
+    auto stop = chrono::high_resolution_clock::now();
+    auto buildDuration = chrono::duration_cast<chrono::microseconds>(stop - start);
+
+    start = chrono::high_resolution_clock::now();
+    uint64_t checksum = 0;
+    for (Rope::Size i = 0; i < rope.getLength(); i++) {
+        checksum += uint8_t(rope[i]);
+    }
+    stop = chrono::high_resolution_clock::now();
+    auto readDuration = chrono::duration_cast<chrono::microseconds>(stop - start);
+
+    cout << "Build: " << buildDuration.count() / 1000.0 << " ms, read: " << readDuration.count() / 1000.0
+         << " ms (checksum " << checksum << ")" << endl;
+    cout << "Leaves: " << rope.getLeafCount() << ", overhead: " << rope.memoryOverhead() << " bytes per byte of text" << endl;
+
+    cout << "----------------------------------------------------------------------------------------------------------------------------------------------" << endl;
+}
+
+void benchmarkOpen(uint32_t sizeMB) {
+
+    cout << "_____________________________________________________________________________________________________________________________________________" << endl;
+    cout << "Open Benchmark:- " << sizeMB << "MB..." << endl;
+
+    string filename = (filesystem::temp_directory_path() / "rope_open.txt").string();
+    {
+        string text = generateText(sizeMB * 1024 * 1024);
+        ofstream file(filename, ios::binary);
+        file.write(text.c_str(), text.length());
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+    Rope* read = new Rope(filename.c_str(), Rope::LoadMode::Read);
+    auto stop = chrono::high_resolution_clock::now();
+    auto readDuration = chrono::duration_cast<chrono::microseconds>(stop - start);
+    cout << "Read: " << readDuration.count() / 1000.0 << " ms, overhead: " << read->memoryOverhead() << endl;
+    delete read;
+
+    start = chrono::high_resolution_clock::now();
+    Rope* mapped = new Rope(filename.c_str(), Rope::LoadMode::Map);
+    stop = chrono::high_resolution_clock::now();
+    auto mapDuration = chrono::duration_cast<chrono::microseconds>(stop - start);
+    cout << "Map: " << mapDuration.count() / 1000.0 << " ms, overhead: " << mapped->memoryOverhead() << endl;
+
+    // A few edits spread over the file only copy the leaves they touch
+    start = chrono::high_resolution_clock::now();
+    for (int i = 0; i < 1000; i++) {
+        mapped->insert(Rope::Size(uint64_t(mapped->getLength()) * i / 1000), "edit", 4);
+    }
+    stop = chrono::high_resolution_clock::now();
+    auto editDuration = chrono::duration_cast<chrono::microseconds>(stop - start);
+    cout << "1000 edits on the mapped rope: " << editDuration.count() / 1000.0 << " ms" << endl;
+    delete mapped;
+
+    // A lazy rope reads nothing at open, and reading the end only faults in the last page
+    start = chrono::high_resolution_clock::now();
+    Rope* lazy = new Rope(filename.c_str(), Rope::LoadMode::Lazy);
+    stop = chrono::high_resolution_clock::now();
+    auto lazyDuration = chrono::duration_cast<chrono::microseconds>(stop - start);
+    cout << "Lazy: " << lazyDuration.count() / 1000.0 << " ms, overhead: " << lazy->memoryOverhead() << endl;
+
+    start = chrono::high_resolution_clock::now();
+    string tail = lazy->substr(lazy->getLength() - 80, 80).toString();
+    stop = chrono::high_resolution_clock::now();
+    auto tailDuration = chrono::duration_cast<chrono::microseconds>(stop - start);
+    cout << "Reading the end: " << tailDuration.count() / 1000.0 << " ms, resident: " << lazy->getResidentBytes() / 1024 << " KB" << endl;
+
+    lazy->setPageBudget(16 << 20);
+    start = chrono::high_resolution_clock::now();
+    Rope::Size lines = lazy->getLineCount();
+    stop = chrono::high_resolution_clock::now();
+    auto countDuration = chrono::duration_cast<chrono::microseconds>(stop - start);
+    cout << "Counting " << lines << " lines: " << countDuration.count() / 1000.0 << " ms, resident: " << lazy->getResidentBytes() / 1024 << " KB" << endl;
+    delete lazy;
+
+    filesystem::remove(filename);
+
+    cout << "----------------------------------------------------------------------------------------------------------------------------------------------" << endl;
+}
+
+void benchmarkHugeFile(uint32_t sizeMB) {
+
+    cout << "_____________________________________________________________________________________________________________________________________________" << endl;
+    cout << "Huge File Benchmark:- " << sizeMB << "MB..." << endl;
+
+    const uint32_t blockSize = 1024 * 1024;
+    const int num_edits = 10000;
+
+    string filename = (filesystem::temp_directory_path() / "rope_huge.txt").string();
+    string block = generateText(blockSize);
+
+    {
+        ofstream file(filename, ios::binary);
+        for (uint32_t i = 0; i < sizeMB; i++) {
+            file.write(block.c_str(), block.length());
+        }
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+    Rope rope(filename.c_str());
+    auto stop = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::milliseconds>(stop - start);
+
+    cout << "Opened " << rope.getLength() << " bytes in " << duration.count() << " ms" << endl;
+
+    srand(time(0));
+
+    start = chrono::high_resolution_clock::now();
+    for (int i = 0; i < num_edits; i++) {
+        Rope::Size pos = ((Rope::Size(rand()) << 30) ^ (Rope::Size(rand()) << 15) ^ Rope::Size(rand())) % rope.getLength();
+        if (i % 2 == 0) {
+            rope.insert(pos, "edit", 4);
+        }
+        else {
+            rope.remove(pos, 4);
+        }
+    }
+    stop = chrono::high_resolution_clock::now();
+
+    cout << "Edits anywhere in the file: " << double(chrono::duration_cast<chrono::nanoseconds>(stop - start).count()) / num_edits
+         << " ns per edit" << endl;
+
+    filesystem::remove(filename);
+
+    cout << "----------------------------------------------------------------------------------------------------------------------------------------------" << endl;
+}
+
 void demo() {
     cout << "Starting demo..." << endl<<endl;
     cout << "*****************************************************************************************************************" << endl;
@@ -574,7 +2218,20 @@ int main() {
     test_diff();
     run_tests();
     benchmark(filenames, 2);
+    benchmarkTrees(filenames, 2);
+    benchmarkInsertScaling(1024);
+    benchmarkAccess(64);
+    benchmarkKeystrokes(64);
+    benchmarkPaste(64, 10);
+    benchmarkReplaceAll(16);
+    benchmarkLogAppend(64);
+    benchmarkClose(256);
+    benchmarkSmallLeaves(500000);
+    benchmarkOpen(256);
+#ifdef ROPE_64BIT
+    benchmarkHugeFile(5 * 1024); // Past the 4GB limit of 32-bit sizes
+#endif
     demo();
 
     return 0;
-}
\ No newline at end of file
+}
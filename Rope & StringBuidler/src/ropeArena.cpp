@@ -0,0 +1,871 @@
+#include "rope.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX // Keep std::min and std::max usable
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Rope::Arena class implementation
+ * Copyright (C) 2022 dhruv
+*/
+
+/**
+ * Constructs an empty Rope::Arena. No memory is reserved until the first allocation.
+ *
+ * @param None
+ *
+ * @return None
+ *
+ * @throws None
+ */
+Rope::Arena::Arena() : freeNodes(nullptr), slabNodesUsed(0), slabNodesCapacity(0), slabBytesUsed(0), slabBytesCapacity(0), pageBudget(Pager::DEFAULT_BUDGET)
+{
+    for (uint32_t i = 0; i < NUM_BUFFER_CLASSES; i++) {
+        freeBuffers[i] = nullptr;
+    }
+}
+
+/**
+ * Destructor for Rope::Arena class. Releases every node and buffer slab in one go.
+ *
+ * @param None
+ *
+ * @return None
+ *
+ * @throws None
+ */
+Rope::Arena::~Arena()
+{
+    clear();
+}
+
+/**
+ * Releases all the memory owned by the arena. Every node and buffer handed out so far becomes invalid.
+ *
+ * @param None
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::Arena::clear()
+{
+    for (void* slab : nodeSlabs) {
+        ::operator delete(slab);
+    }
+    nodeSlabs.clear();
+    freeNodes = nullptr;
+    slabNodesUsed = 0;
+    slabNodesCapacity = 0;
+
+    for (char* slab : bufferSlabs) {
+        delete[] slab;
+    }
+    bufferSlabs.clear();
+    slabBytesUsed = 0;
+    slabBytesCapacity = 0;
+
+    for (uint32_t i = 0; i < NUM_BUFFER_CLASSES; i++) {
+        freeBuffers[i] = nullptr;
+    }
+
+    for (char* buffer : largeBuffers) {
+        delete[] buffer;
+    }
+    largeBuffers.clear();
+
+    pagers.clear();
+
+    for (const Mapping& mapping : mappings) {
+        unmap(mapping);
+    }
+    mappings.clear();
+}
+
+/*
+* NODE SLABS
+* ==========
+* Nodes are all the same size, so they are handed out from slabs of slots that double
+* in size up to MAX_NODES_PER_SLAB. Freed slots are pushed on an intrusive free list
+* and reused first.
+*   - allocateNode
+*   - freeNode
+*/
+
+/**
+ * Returns an uninitialized slot big enough to hold one Rope::Node.
+ *
+ * @param None
+ *
+ * @return Pointer to the slot, to be constructed with placement new.
+ *
+ * @throws std::bad_alloc if a new slab cannot be allocated.
+ */
+void* Rope::Arena::allocateNode()
+{
+    if (freeNodes != nullptr) {
+        FreeSlot* slot = freeNodes;
+        freeNodes = slot->next;
+        return slot;
+    }
+
+    if (slabNodesUsed == slabNodesCapacity) {
+        slabNodesCapacity = min(max(slabNodesCapacity * 2, MIN_NODES_PER_SLAB), MAX_NODES_PER_SLAB);
+        nodeSlabs.push_back(::operator new(sizeof(Node) * slabNodesCapacity));
+        slabNodesUsed = 0;
+    }
+
+    char* slab = static_cast<char*>(nodeSlabs.back());
+    return slab + sizeof(Node) * slabNodesUsed++;
+}
+
+/**
+ * Returns a node slot to the free list so the next allocation can reuse it.
+ *
+ * @param slot The slot previously returned by allocateNode.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::Arena::freeNode(void* slot)
+{
+    if (slot == nullptr) return;
+
+    FreeSlot* freeSlot = static_cast<FreeSlot*>(slot);
+    freeSlot->next = freeNodes;
+    freeNodes = freeSlot;
+}
+
+/*
+* LEAF BUFFER POOL
+* ================
+* Leaf text is rounded up to a size class and bump-allocated from slabs that double
+* in size up to MAX_BUFFER_SLAB_SIZE. Classes are 8 bytes apart up to 32 bytes, then
+* split every power of two into four steps, so rounding wastes at most 25%.
+* Each class keeps its own free list. Requests above MAX_BUFFER_SIZE are allocated
+* individually and returned to the system on free.
+*   - bufferClass
+*   - classSize
+*   - bufferCapacity
+*   - allocateBuffer
+*   - freeBuffer
+*/
+
+/**
+ * Computes the size class used for a buffer of the given size.
+ *
+ * @param size The number of bytes requested, at most MAX_BUFFER_SIZE.
+ *
+ * @return The index of the smallest class that fits the request.
+ *
+ * @throws None
+ */
+uint32_t Rope::Arena::bufferClass(uint32_t size)
+{
+    if (size <= 32) {
+        return size <= 8 ? 0 : (size - 1) / 8;
+    }
+
+    uint32_t power = 5;
+    while ((uint64_t(1) << (power + 1)) < size) {
+        power++;
+    }
+
+    uint32_t step = (uint32_t(1) << power) / 4;
+    uint32_t steps = (size - (uint32_t(1) << power) + step - 1) / step; // 1 to 4
+
+    return 4 + (power - 5) * 4 + (steps - 1);
+}
+
+/**
+ * Computes the number of bytes in a buffer of the given size class.
+ *
+ * @param sizeClass The index of the class.
+ *
+ * @return The size of the buffers handed out for that class.
+ *
+ * @throws None
+ */
+uint32_t Rope::Arena::classSize(uint32_t sizeClass)
+{
+    if (sizeClass < 4) {
+        return (sizeClass + 1) * 8;
+    }
+
+    uint32_t power = 5 + (sizeClass - 4) / 4;
+    uint32_t steps = (sizeClass - 4) % 4 + 1;
+
+    return (uint32_t(1) << power) + steps * ((uint32_t(1) << power) / 4);
+}
+
+/**
+ * Computes how many bytes the arena really reserves for a buffer request.
+ *
+ * @param size The number of bytes requested.
+ *
+ * @return The capacity of the buffer that allocateBuffer would return.
+ *
+ * @throws None
+ */
+uint32_t Rope::Arena::bufferCapacity(uint32_t size)
+{
+    return size > MAX_BUFFER_SIZE ? size : classSize(bufferClass(size));
+}
+
+/**
+ * Allocates a buffer of at least the given size.
+ *
+ * @param size The number of bytes needed.
+ *
+ * @return Pointer to the buffer.
+ *
+ * @throws std::bad_alloc if a new slab cannot be allocated.
+ */
+char* Rope::Arena::allocateBuffer(uint32_t size)
+{
+    if (size > MAX_BUFFER_SIZE) {
+        char* buffer = new char[size];
+        largeBuffers.insert(buffer);
+        return buffer;
+    }
+
+    uint32_t sizeClass = bufferClass(size);
+
+    if (freeBuffers[sizeClass] != nullptr) {
+        FreeSlot* slot = freeBuffers[sizeClass];
+        freeBuffers[sizeClass] = slot->next;
+        return reinterpret_cast<char*>(slot);
+    }
+
+    uint32_t capacity = classSize(sizeClass);
+    if (slabBytesUsed + capacity > slabBytesCapacity) {
+        slabBytesCapacity = min(max(slabBytesCapacity * 2, MIN_BUFFER_SLAB_SIZE), MAX_BUFFER_SLAB_SIZE);
+        slabBytesCapacity = max(slabBytesCapacity, capacity);
+        bufferSlabs.push_back(new char[slabBytesCapacity]);
+        slabBytesUsed = 0;
+    }
+
+    char* buffer = bufferSlabs.back() + slabBytesUsed;
+    slabBytesUsed += capacity;
+    return buffer;
+}
+
+/**
+ * Returns a buffer to the pool of its size class.
+ *
+ * @param buffer The buffer previously returned by allocateBuffer.
+ * @param size The size that was passed to allocateBuffer.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::Arena::freeBuffer(char* buffer, uint32_t size)
+{
+    if (buffer == nullptr) return;
+
+    if (size > MAX_BUFFER_SIZE) {
+        largeBuffers.erase(buffer);
+        delete[] buffer;
+        return;
+    }
+
+    uint32_t sizeClass = bufferClass(size);
+
+    FreeSlot* slot = reinterpret_cast<FreeSlot*>(buffer);
+    slot->next = freeBuffers[sizeClass];
+    freeBuffers[sizeClass] = slot;
+}
+
+/*
+* SHARED BUFFERS
+* ==============
+* Leaf text lives in reference-counted buffers so that splitting a leaf only
+* creates a second slice of the same bytes instead of copying them.
+*   - createBuffer
+*   - retain
+*   - release
+*/
+
+/**
+ * Allocates a shared buffer with room for at least the given number of text bytes and one reference.
+ * The buffer keeps the whole size class as its capacity, the bytes past the text are slack
+ * that in-place leaf edits can grow into.
+ *
+ * @param size The number of text bytes.
+ *
+ * @return The new buffer.
+ *
+ * @throws std::bad_alloc if a new slab cannot be allocated.
+ */
+Rope::Buffer* Rope::Arena::createBuffer(uint32_t size)
+{
+    Buffer* buffer = reinterpret_cast<Buffer*>(allocateBuffer(sizeof(Buffer) + size));
+    buffer->refs = 1;
+    buffer->size = bufferCapacity(sizeof(Buffer) + size) - sizeof(Buffer);
+    return buffer;
+}
+
+/**
+ * Adds a reference to a shared buffer.
+ *
+ * @param buffer The buffer, may be nullptr.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::Arena::retain(Buffer* buffer)
+{
+    if (buffer != nullptr) {
+        buffer->refs++;
+    }
+}
+
+/**
+ * Drops a reference to a shared buffer and returns it to the pool when it was the last one.
+ *
+ * @param buffer The buffer, may be nullptr.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::Arena::release(Buffer* buffer)
+{
+    if (buffer == nullptr) return;
+
+    if (--buffer->refs == 0) {
+        freeBuffer(reinterpret_cast<char*>(buffer), sizeof(Buffer) + buffer->size);
+    }
+}
+
+/*
+* FILE MAPPINGS
+* =============
+* A file opened with LoadMode::Map is mapped read-only and its leaves view the mapping
+* instead of copying it. The mapping belongs to the arena, so it stays valid for every rope
+* that may share those leaves, and it is unmapped when the arena is cleared. The pages are
+* backed by the file, the system reads them in when touched and drops them under pressure.
+*   - mapFile
+*   - hasMappings
+*   - mapsFile
+*   - unmapFile
+*   - liveNodes
+*   - unmap
+*/
+
+/**
+ * Maps a whole file read-only for the lifetime of the arena.
+ *
+ * @param filename The name of the file.
+ * @param length Set to the length of the file.
+ *
+ * @return The first byte of the mapping, or nullptr if the file cannot be mapped or is empty.
+ *
+ * @throws std::bad_alloc if the list of mappings cannot grow.
+ */
+const char* Rope::Arena::mapFile(const char filename[], uint64_t& length)
+{
+    length = 0;
+    void* address = nullptr;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping != nullptr) {
+            address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping); // The view keeps the mapping alive
+        }
+        length = uint64_t(size.QuadPart);
+    }
+    CloseHandle(file);
+#else
+    int file = open(filename, O_RDONLY);
+    if (file < 0) return nullptr;
+
+    struct stat info;
+    if (fstat(file, &info) == 0 && info.st_size > 0) {
+        address = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (address == MAP_FAILED) {
+            address = nullptr;
+        }
+        length = uint64_t(info.st_size);
+    }
+    close(file); // The mapping keeps the file alive
+#endif
+
+    if (address == nullptr) {
+        length = 0;
+        return nullptr;
+    }
+
+    mappings.push_back({address, size_t(length), filename});
+    return static_cast<const char*>(address);
+}
+
+/**
+ * Tells whether any leaf of the arena may view a mapped file.
+ *
+ * @return true if the arena holds a mapping.
+ */
+bool Rope::Arena::hasMappings() const
+{
+    return !mappings.empty();
+}
+
+/**
+ * Tells whether the arena maps a given file, under this name or any other path to it.
+ *
+ * @param filename The name of the file.
+ *
+ * @return true if some leaf of the arena may view the file.
+ */
+bool Rope::Arena::mapsFile(const char filename[]) const
+{
+    for (const Mapping& mapping : mappings) {
+        error_code error;
+        if (filesystem::equivalent(mapping.filename, filename, error)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Lets go of a mapped file, so that it can be replaced. Every live leaf of the arena still
+ * viewing it, whichever rope it belongs to, moves its text to an arena buffer first. The
+ * text does not change, so this is safe on leaves shared between ropes, but iterators
+ * holding a pointer into the mapping are invalidated. Files larger than memory cannot be
+ * let go of this way.
+ *
+ * @param filename The name of the file.
+ *
+ * @return void
+ *
+ * @throws std::bad_alloc if the text cannot be copied into the arena.
+ */
+void Rope::Arena::unmapFile(const char filename[])
+{
+    for (size_t i = 0; i < mappings.size();) {
+        error_code error;
+        if (!filesystem::equivalent(mappings[i].filename, filename, error)) {
+            i++;
+            continue;
+        }
+
+        const char* begin = static_cast<const char*>(mappings[i].address);
+        const char* end = begin + mappings[i].length;
+
+        for (Node* node : liveNodes()) {
+            const char* text = node->getIsMapped() ? node->getData() : nullptr;
+            if (text >= begin && text < end) {
+                node->setData(*this, text, node->getLength());
+            }
+        }
+
+        pagers.erase(remove_if(pagers.begin(), pagers.end(), [begin](const unique_ptr<Pager>& pager) {
+            return pager->getBase() == begin;
+        }), pagers.end());
+
+        unmap(mappings[i]);
+        mappings.erase(mappings.begin() + i);
+    }
+}
+
+/**
+ * Lists the nodes allocated from the arena and not freed since. Slabs fill up in order and
+ * their sizes follow the same doubling as in allocateNode(), so every slot up to the last
+ * one handed out holds a node unless it is on the free list.
+ *
+ * @return The live nodes.
+ *
+ * @throws std::bad_alloc if the list cannot be allocated.
+ */
+vector<Rope::Node*> Rope::Arena::liveNodes() const
+{
+    unordered_set<const void*> freeSlots;
+    for (FreeSlot* slot = freeNodes; slot != nullptr; slot = slot->next) {
+        freeSlots.insert(slot);
+    }
+
+    vector<Node*> nodes;
+    uint32_t capacity = 0;
+
+    for (size_t i = 0; i < nodeSlabs.size(); i++) {
+        capacity = min(max(capacity * 2, MIN_NODES_PER_SLAB), MAX_NODES_PER_SLAB);
+        uint32_t used = i + 1 == nodeSlabs.size() ? slabNodesUsed : capacity;
+
+        Node* slab = static_cast<Node*>(nodeSlabs[i]);
+        for (uint32_t j = 0; j < used; j++) {
+            if (freeSlots.count(slab + j) == 0) {
+                nodes.push_back(slab + j);
+            }
+        }
+    }
+
+    return nodes;
+}
+
+/**
+ * Hands a mapping back to the system.
+ *
+ * @param mapping The mapping.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::Arena::unmap(const Mapping& mapping)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(mapping.address);
+#else
+    munmap(mapping.address, mapping.length);
+#endif
+}
+
+/*
+* LAZY LOADING
+* ============
+* A file opened with LoadMode::Lazy is mapped like with LoadMode::Map, but its tree is a
+* skeleton of Paged leaves, one per Pager::PAGE_SIZE bytes, built without reading the file.
+* A page is only faulted in when a read or an edit reaches its leaf, and the pager of the
+* file hands the least recently read pages back to the system once the budget is exceeded.
+*   - createPager
+*   - setPageBudget
+*   - getResidentBytes
+*   - Pager
+*   - pageLength
+*   - touch
+*   - unlink
+*   - evict
+*   - setBudget
+*/
+
+/**
+ * Creates the pager of a lazily loaded file, owned by the arena like the mapping itself.
+ *
+ * @param text The first byte of the mapping.
+ * @param length The length of the mapping.
+ *
+ * @return The new pager, with the budget of the arena.
+ *
+ * @throws std::bad_alloc if the page table cannot be allocated.
+ */
+Rope::Pager* Rope::Arena::createPager(const char* text, uint64_t length)
+{
+    pagers.push_back(make_unique<Pager>(text, length, pageBudget));
+    return pagers.back().get();
+}
+
+/**
+ * Sets how many bytes of each lazily loaded file may stay resident, evicting pages right away
+ * if needed. Files loaded later get the same budget.
+ *
+ * @param budget The budget in bytes, at least one page is always kept.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::Arena::setPageBudget(size_t budget)
+{
+    pageBudget = budget;
+    for (const unique_ptr<Pager>& pager : pagers) {
+        pager->setBudget(budget);
+    }
+}
+
+/**
+ * Retrieves how many bytes of lazily loaded files have been read and not evicted since.
+ *
+ * @return The number of resident bytes over every pager of the arena.
+ */
+size_t Rope::Arena::getResidentBytes() const
+{
+    size_t total = 0;
+    for (const unique_ptr<Pager>& pager : pagers) {
+        total += pager->getResidentBytes();
+    }
+    return total;
+}
+
+/**
+ * Constructs a pager with no page resident.
+ *
+ * @param base The first byte of the mapping, aligned on a system page.
+ * @param length The length of the mapping.
+ * @param budget The number of bytes that may stay resident.
+ *
+ * @throws std::bad_alloc if the page table cannot be allocated.
+ */
+Rope::Pager::Pager(const char* base, uint64_t length, size_t budget)
+    : base(base), length(length), pages(size_t((length + PAGE_SIZE - 1) / PAGE_SIZE), Page{NONE, NONE, false}),
+      newest(NONE), oldest(NONE), budget(budget), residentBytes(0)
+{
+}
+
+/**
+ * Computes the length of a page, only the last one can be shorter than PAGE_SIZE.
+ *
+ * @param page The index of the page.
+ *
+ * @return The number of bytes of the file in the page.
+ *
+ * @throws None
+ */
+uint32_t Rope::Pager::pageLength(uint32_t page) const
+{
+    return uint32_t(min<uint64_t>(PAGE_SIZE, length - uint64_t(page) * PAGE_SIZE));
+}
+
+/**
+ * Records a read of the page holding some text, making it the most recently read page.
+ * A page read for the first time counts against the budget, and the oldest pages are
+ * evicted until the resident pages fit again. Reads in the page of the last read return
+ * without taking the lock, so scanning a leaf byte by byte stays cheap.
+ *
+ * @param text A byte inside the mapping.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::Pager::touch(const char* text)
+{
+    uint32_t page = uint32_t(uint64_t(text - base) / PAGE_SIZE);
+    if (newest.load(memory_order_relaxed) == page) return;
+
+    lock_guard<mutex> guard(lock);
+
+    if (pages[page].resident) {
+        unlink(page);
+    }
+    else {
+        pages[page].resident = true;
+        residentBytes += pageLength(page);
+    }
+
+    uint32_t previous = newest.load(memory_order_relaxed);
+    pages[page].older = previous;
+    pages[page].newer = NONE;
+    if (previous != NONE) {
+        pages[previous].newer = page;
+    }
+    else {
+        oldest = page;
+    }
+    newest.store(page, memory_order_relaxed);
+
+    while (residentBytes > budget && oldest != page) {
+        evict(oldest);
+    }
+}
+
+/**
+ * Takes a resident page out of the list ordered by time of last read.
+ *
+ * @param page The index of the page.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::Pager::unlink(uint32_t page)
+{
+    Page& entry = pages[page];
+
+    if (entry.newer != NONE) {
+        pages[entry.newer].older = entry.older;
+    }
+    else {
+        newest.store(entry.older, memory_order_relaxed);
+    }
+
+    if (entry.older != NONE) {
+        pages[entry.older].newer = entry.newer;
+    }
+    else {
+        oldest = entry.newer;
+    }
+
+    entry.newer = entry.older = NONE;
+}
+
+/**
+ * Hands a resident page back to the system. The mapping is private and never written,
+ * so the page is a clean copy of the file and the next read faults it in again.
+ *
+ * @param page The index of the page.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::Pager::evict(uint32_t page)
+{
+    unlink(page);
+    pages[page].resident = false;
+    residentBytes -= pageLength(page);
+
+    void* address = const_cast<char*>(base + uint64_t(page) * PAGE_SIZE);
+#ifdef _WIN32
+    VirtualUnlock(address, pageLength(page)); // Removes pages that are not locked from the working set
+#else
+    madvise(address, pageLength(page), MADV_DONTNEED);
+#endif
+}
+
+/**
+ * Changes the budget, evicting the oldest pages until the resident ones fit.
+ *
+ * @param budget The budget in bytes, the most recently read page is always kept.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::Pager::setBudget(size_t budget)
+{
+    lock_guard<mutex> guard(lock);
+
+    this->budget = budget;
+    while (residentBytes > budget && oldest != newest.load(memory_order_relaxed)) {
+        evict(oldest);
+    }
+}
+
+/**
+ * Retrieves how many bytes of the file have been read and not evicted since.
+ *
+ * @return The number of resident bytes.
+ */
+size_t Rope::Pager::getResidentBytes() const
+{
+    lock_guard<mutex> guard(lock);
+    return residentBytes;
+}
+
+/*
+* BACKGROUND RECLAMATION
+* ======================
+* Freeing the arena of a large document releases thousands of slabs. Rope::reclaim() hands
+* the arena to a worker thread instead, so closing a document returns at once.
+*   - instance
+*   - Reclaimer
+*   - ~Reclaimer
+*   - push
+*   - wait
+*   - run
+*/
+
+/**
+ * Retrieves the reclaimer shared by every rope, starting its worker on first use.
+ *
+ * @return The reclaimer.
+ *
+ * @throws std::system_error if the worker thread cannot be started.
+ */
+Rope::Reclaimer& Rope::Reclaimer::instance()
+{
+    static Reclaimer reclaimer;
+    return reclaimer;
+}
+
+/**
+ * Constructs the reclaimer and starts its worker thread.
+ *
+ * @throws std::system_error if the worker thread cannot be started.
+ */
+Rope::Reclaimer::Reclaimer() : busy(false), stopping(false), worker(&Reclaimer::run, this)
+{
+}
+
+/**
+ * Destructor for Rope::Reclaimer. Lets the worker free the arenas still queued, then joins it.
+ *
+ * @throws None
+ */
+Rope::Reclaimer::~Reclaimer()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    ready.notify_one();
+    worker.join();
+}
+
+/**
+ * Queues an arena to be destroyed on the worker thread.
+ *
+ * @param arena The arena, no other rope may hold it.
+ *
+ * @return void
+ *
+ * @throws std::bad_alloc if the queue cannot grow.
+ */
+void Rope::Reclaimer::push(shared_ptr<Arena> arena)
+{
+    {
+        lock_guard<mutex> guard(lock);
+        queue.push_back(std::move(arena));
+    }
+    ready.notify_one();
+}
+
+/**
+ * Blocks until every queued arena has been destroyed.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::Reclaimer::wait()
+{
+    unique_lock<mutex> guard(lock);
+    idle.wait(guard, [this] { return queue.empty() && !busy; });
+}
+
+/**
+ * Body of the worker thread. Destroys queued arenas one at a time outside the lock,
+ * until it is asked to stop and the queue is empty.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::Reclaimer::run()
+{
+    unique_lock<mutex> guard(lock);
+
+    while (true) {
+        ready.wait(guard, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) break; // Stopping, and nothing left to free
+
+        shared_ptr<Arena> arena = std::move(queue.back());
+        queue.pop_back();
+        busy = true;
+
+        guard.unlock();
+        arena.reset(); // Releases every slab of the arena
+        guard.lock();
+
+        busy = false;
+        if (queue.empty()) {
+            idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,517 @@
+#include "rope.hpp"
+
+/*
+ * Rope iterator classes implementation
+ * Copyright (C) 2022 dhruv
+*/
+
+/*
+* CHUNK ITERATOR
+* ==============
+* - ChunkIterator
+* - seek
+* - descend
+* - operator*
+* - getOffset
+* - operator++
+* - operator--
+*/
+
+/**
+ * Constructs a chunk iterator on the leaf holding a position.
+ *
+ * @param root The root of the rope, may be nullptr.
+ * @param pos The position to seek to, positions past the end give the end iterator.
+ *
+ * @throws None
+ */
+Rope::ChunkIterator::ChunkIterator(const Node* root, Size pos)
+{
+    seek(root, pos);
+}
+
+/**
+ * Moves the iterator to the leaf holding a position, descending from the root by weight.
+ * The path keeps its storage, so seeking an existing iterator does not allocate.
+ *
+ * @param root The root of the rope, may be nullptr.
+ * @param pos The position to seek to, positions past the end give the end iterator.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::ChunkIterator::seek(const Node* root, Size pos)
+{
+    this->root = root;
+    path.clear();
+    leaf = nullptr;
+
+    if (root == nullptr || pos >= root->getWeight()) {
+        start = root ? root->getWeight() : 0;
+        return;
+    }
+
+    const Node* node = root;
+    Size offset = pos;
+
+    while (!node->getIsLeaf()) {
+        const Node* left = node->getLeft();
+        bool right = offset >= left->getWeight();
+
+        path.push_back({node, right});
+
+        if (right) {
+            offset -= left->getWeight();
+            node = node->getRight();
+        }
+        else {
+            node = left;
+        }
+    }
+
+    leaf = node;
+    start = pos - offset;
+}
+
+/**
+ * Moves down from a node to its first or last leaf, recording the path.
+ *
+ * @param node The node to start from.
+ * @param last Whether to go to the last leaf rather than the first one.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::ChunkIterator::descend(const Node* node, bool last)
+{
+    while (!node->getIsLeaf()) {
+        path.push_back({node, last});
+        node = last ? node->getRight() : node->getLeft();
+    }
+    leaf = node;
+}
+
+/**
+ * Retrieves the text of the current leaf without copying it.
+ *
+ * @return A view of the chunk, empty past the last chunk.
+ */
+string_view Rope::ChunkIterator::operator*() const
+{
+    return leaf ? string_view(leaf->getData(), leaf->getLength()) : string_view();
+}
+
+/**
+ * Retrieves the position of the current chunk in the rope.
+ *
+ * @return The position of the first byte of the chunk, or the length of the rope past the last chunk.
+ */
+Rope::Size Rope::ChunkIterator::getOffset() const
+{
+    return start;
+}
+
+/**
+ * Moves to the next leaf by climbing to the nearest ancestor entered from the left
+ * and descending to the first leaf of its right subtree.
+ *
+ * @return This iterator.
+ *
+ * @throws None
+ */
+Rope::ChunkIterator& Rope::ChunkIterator::operator++()
+{
+    if (leaf == nullptr) return *this;
+
+    start += leaf->getLength();
+
+    while (!path.empty() && path.back().right) {
+        path.pop_back();
+    }
+
+    if (path.empty()) { // That was the last leaf
+        leaf = nullptr;
+        return *this;
+    }
+
+    path.back().right = true;
+    descend(path.back().node->getRight(), false);
+
+    return *this;
+}
+
+/**
+ * Moves to the previous leaf, or to the last leaf from the end iterator.
+ * Stepping back from the first leaf leaves the iterator unchanged.
+ *
+ * @return This iterator.
+ *
+ * @throws None
+ */
+Rope::ChunkIterator& Rope::ChunkIterator::operator--()
+{
+    if (leaf == nullptr) {
+        if (root == nullptr) return *this;
+
+        path.clear();
+        descend(root, true);
+        start = root->getWeight() - leaf->getLength();
+        return *this;
+    }
+
+    size_t depth = path.size();
+    while (depth > 0 && !path[depth - 1].right) {
+        depth--;
+    }
+
+    if (depth == 0) return *this; // Already on the first leaf
+
+    path.resize(depth);
+    path.back().right = false;
+    descend(path.back().node->getLeft(), true);
+    start -= leaf->getLength();
+
+    return *this;
+}
+
+/*
+* BYTE ITERATOR
+* =============
+* - ByteIterator
+* - loadChunk
+* - operator++
+* - operator--
+*/
+
+/**
+ * Constructs a byte iterator on a position inside a chunk.
+ *
+ * @param chunk The chunk holding the position.
+ * @param pos The position in the rope.
+ *
+ * @throws None
+ */
+Rope::ByteIterator::ByteIterator(const ChunkIterator& chunk, Size pos) : chunk(chunk)
+{
+    loadChunk();
+    index = data ? uint32_t(pos - chunk.getOffset()) : 0;
+}
+
+/**
+ * Caches the text of the current chunk.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::ByteIterator::loadChunk()
+{
+    string_view text = *chunk;
+    data = text.empty() ? nullptr : text.data();
+    length = uint32_t(text.size());
+    index = 0;
+}
+
+/**
+ * Moves to the next byte.
+ *
+ * @return This iterator.
+ *
+ * @throws None
+ */
+Rope::ByteIterator& Rope::ByteIterator::operator++()
+{
+    if (data != nullptr && ++index == length) {
+        ++chunk;
+        loadChunk();
+    }
+    return *this;
+}
+
+/**
+ * Moves to the previous byte.
+ *
+ * @return This iterator.
+ *
+ * @throws None
+ */
+Rope::ByteIterator& Rope::ByteIterator::operator--()
+{
+    if (index > 0) {
+        index--;
+        return *this;
+    }
+
+    Size pos = chunk.getOffset();
+    if (pos == 0) return *this; // Already on the first byte
+
+    --chunk;
+    loadChunk();
+    index = length - 1;
+
+    return *this;
+}
+
+/*
+* CHAR ITERATOR
+* =============
+* - operator*
+* - operator++
+* - operator--
+*/
+
+/**
+ * Decodes the code point starting at the current byte.
+ *
+ * @return The code point.
+ *
+ * @throws None
+ */
+char32_t Rope::CharIterator::operator*() const
+{
+    unsigned char lead = *byte;
+
+    int extra = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+    char32_t code = extra == 0 ? lead : lead & (0x3F >> extra);
+
+    ByteIterator curr = byte;
+    for (int i = 0; i < extra; i++) {
+        ++curr;
+        if (curr.atEnd() || (static_cast<unsigned char>(*curr) & 0xC0) != 0x80) {
+            return lead; // Truncated sequence
+        }
+        code = (code << 6) | (static_cast<unsigned char>(*curr) & 0x3F);
+    }
+
+    return code;
+}
+
+/**
+ * Moves to the next code point, skipping the continuation bytes of the current one.
+ *
+ * @return This iterator.
+ *
+ * @throws None
+ */
+Rope::CharIterator& Rope::CharIterator::operator++()
+{
+    ++byte;
+    while (!byte.atEnd() && (static_cast<unsigned char>(*byte) & 0xC0) == 0x80) {
+        ++byte;
+    }
+    return *this;
+}
+
+/**
+ * Moves to the previous code point.
+ *
+ * @return This iterator.
+ *
+ * @throws None
+ */
+Rope::CharIterator& Rope::CharIterator::operator--()
+{
+    --byte;
+    while (byte.getPosition() > 0 && (static_cast<unsigned char>(*byte) & 0xC0) == 0x80) {
+        --byte;
+    }
+    return *this;
+}
+
+/*
+* ROPE ITERATOR FUNCTIONS
+* =======================
+* Readers walk the leaves in place instead of flattening the rope with toString().
+* - chunksBegin
+* - chunksEnd
+* - chunksAt
+* - begin
+* - end
+* - bytesAt
+* - charsBegin
+* - charsEnd
+* - charsAt
+* - find
+*/
+
+/**
+ * Retrieves an iterator on the first chunk of the rope.
+ *
+ * @return The chunk iterator.
+ */
+Rope::ChunkIterator Rope::chunksBegin() const
+{
+    return ChunkIterator(root, 0);
+}
+
+/**
+ * Retrieves the iterator past the last chunk of the rope.
+ *
+ * @return The end chunk iterator.
+ */
+Rope::ChunkIterator Rope::chunksEnd() const
+{
+    return ChunkIterator(root, getLength());
+}
+
+/**
+ * Retrieves an iterator on the chunk holding a position, in O(log n).
+ *
+ * @param pos The position in the rope.
+ *
+ * @return The chunk iterator.
+ */
+Rope::ChunkIterator Rope::chunksAt(Size pos) const
+{
+    return ChunkIterator(root, pos);
+}
+
+/**
+ * Retrieves an iterator on the first byte of the rope.
+ *
+ * @return The byte iterator.
+ */
+Rope::ByteIterator Rope::begin() const
+{
+    return bytesAt(0);
+}
+
+/**
+ * Retrieves the iterator past the last byte of the rope.
+ *
+ * @return The end byte iterator.
+ */
+Rope::ByteIterator Rope::end() const
+{
+    return bytesAt(getLength());
+}
+
+/**
+ * Retrieves an iterator on a byte of the rope, in O(log n).
+ *
+ * @param pos The position of the byte.
+ *
+ * @return The byte iterator.
+ */
+Rope::ByteIterator Rope::bytesAt(Size pos) const
+{
+    pos = min(pos, getLength());
+    return ByteIterator(ChunkIterator(root, pos), pos);
+}
+
+/**
+ * Retrieves an iterator on the first code point of the rope.
+ *
+ * @return The code point iterator.
+ */
+Rope::CharIterator Rope::charsBegin() const
+{
+    return CharIterator(begin());
+}
+
+/**
+ * Retrieves the iterator past the last code point of the rope.
+ *
+ * @return The end code point iterator.
+ */
+Rope::CharIterator Rope::charsEnd() const
+{
+    return CharIterator(end());
+}
+
+/**
+ * Retrieves an iterator on the code point starting at a byte offset, in O(log n).
+ *
+ * @param pos The byte offset of the code point.
+ *
+ * @return The code point iterator.
+ */
+Rope::CharIterator Rope::charsAt(Size pos) const
+{
+    return CharIterator(bytesAt(pos));
+}
+
+/**
+ * Searches the rope for a string without flattening it.
+ *
+ * @param s The string to search for.
+ * @param len The length of the string.
+ * @param from The position to start searching from.
+ *
+ * @return The position of the first match at or after `from`, or npos if there is none.
+ *
+ * @throws None
+ */
+Rope::Size Rope::find(const char s[], Size len, Size from) const
+{
+    if (from > getLength()) return npos;
+
+    ByteIterator match = std::search(bytesAt(from), end(), s, s + len);
+
+    return match.atEnd() && len > 0 ? npos : match.getPosition();
+}
+
+/*
+* INDEXED ACCESS
+* ==============
+* Indexed reads go through lastLeaf, a chunk iterator left on the leaf of the previous read.
+* A read in that leaf costs O(1) and a read in the next or previous leaf steps the iterator
+* (O(1) amortized), so scanning the text or moving a cursor never descends from the root.
+* Any other position seeks in O(log n). Edits reset lastLeaf.
+* - at
+* - operator[]
+*/
+
+/**
+ * Retrieves the character at a position, checking the position.
+ *
+ * @param pos The position of the character.
+ *
+ * @return The character.
+ *
+ * @throws std::out_of_range if pos is not less than the length of the rope.
+ */
+char Rope::at(Size pos) const
+{
+    if (pos >= getLength()) {
+        throw out_of_range("Rope::at: position " + to_string(pos) + " is out of range");
+    }
+
+    return (*this)[pos];
+}
+
+/**
+ * Retrieves the character at a position. Like std::string, the position is not checked.
+ *
+ * @param pos The position of the character, less than the length of the rope.
+ *
+ * @return The character.
+ *
+ * @throws None
+ */
+char Rope::operator[](Size pos) const
+{
+    Size start = lastLeaf.getOffset();
+    Size length = (*lastLeaf).size();
+
+    if (pos < start || pos - start >= length) {
+        if (length > 0 && pos >= start + length) {
+            ++lastLeaf;
+        }
+        else if (length > 0) {
+            --lastLeaf;
+        }
+
+        start = lastLeaf.getOffset();
+        length = (*lastLeaf).size();
+
+        if (pos < start || pos - start >= length) {
+            lastLeaf.seek(root, pos);
+            start = lastLeaf.getOffset();
+        }
+    }
+
+    return (*lastLeaf)[pos - start];
+}
@@ -21,17 +21,19 @@ void StringBuilder::remove(size_t pos, size_t len) {
 }
 
 void StringBuilder::load(const std::string& filename) {
-    ifstream file(filename);
+    ifstream file(filename, ios::binary | ios::ate);
 
     if (!file.is_open()) {
         cerr << "Error opening file" << std::endl;
         return;
     }
 
-    string line;
-    while (getline(file, line)) {
-        append(line);
-    }
+    // Read the whole file in one go, every byte as it is
+    size_t start = buffer.length();
+    buffer.resize(start + size_t(file.tellg()));
+    file.seekg(0);
+    file.read(&buffer[start], buffer.length() - start);
+    buffer.resize(start + size_t(file.gcount()));
 }
 
 const string& StringBuilder::toString() const {
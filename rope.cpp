@@ -1,5 +1,6 @@
 #include "rope.hpp"
 
+
 /*
 * Rope class implementation
 * Copyright (C) 2022 dhruv
@@ -15,68 +16,62 @@
  *
  * @throws None.
  */
-Rope::Rope(const char str[], uint32_t len) : root(nullptr)
+Rope::Rope(const char str[], Size len) : root(nullptr)
 {   
     adjustParameters(len);
 
-    vector<pair<char*, uint32_t>> chunks = splitTextIntoChunks(str, len);
-
-    for (auto& chunk : chunks) {
-        
-        if (chunk.first == nullptr) {
-            continue;
-        }
-
-        Node *newNode = new Node(chunk.first, chunk.second);
-
-        if (root == nullptr) {
-            root = newNode;
-            continue;
-        }
-        root = merge(root, newNode);
-        delete[] chunk.first; // delete the memory allocated for the chunk
-    }
+    root = buildTree(str, len);
 }
 
-Rope::Rope(Node* node) : root(node) {
-    adjustParameters(node->getWeight());
+/**
+ * Constructor for the Rope class. Copies the given subtree into the new rope's own arena.
+ *
+ * @param node The subtree to copy.
+ *
+ * @throws None.
+ */
+Rope::Rope(Node* node) : root(nullptr) {
+    adjustParameters(node ? node->getWeight() : 0);
     
+    root = copyNode(node);
 }
 
-Rope::Rope(Node* left, Node* right)
+/**
+ * Constructor for the Rope class. Copies the given subtrees into the new rope's arena and joins them.
+ *
+ * @param left The subtree holding the beginning of the text.
+ * @param right The subtree holding the end of the text.
+ *
+ * @throws None.
+ */
+Rope::Rope(Node* left, Node* right) : root(nullptr)
 {
     adjustParameters(left->getWeight() + right->getWeight());
     
-    root = new Node(left, right);
+    root = createNode(copyNode(left), copyNode(right));
     
 }
 
 /**
  * Constructor for the Rope class. Reads a file and creates a new Rope object with the contents of the file.
+ * If the file cannot be opened or is too large, an error is printed and the rope is left empty.
  *
  * @param filename The name of the file to read.
+ * @param mode Whether to copy the file into the rope or to view a mapping of it, see load().
  *
- * @throws std::runtime_error if the file cannot be opened or read.
+ * @throws None.
  */
-Rope::Rope(const char filename[]) : root(nullptr)
+Rope::Rope(const char filename[], LoadMode mode) : root(nullptr)
 {
-    // TODO: Read file and create rope
-    ifstream file (filename, ios::ate | ios::binary | ios::in);
-
-    if (!file.is_open()) {
-        cout << "Error opening file" << endl;
-        return;
-    }
-
-    adjustParameters(file.tellg());
-
-    load(filename);
+    load(filename, mode);
 }
 
 Rope::Rope() : root(nullptr) { adjustParameters(0); }
 
 /**
- * Destructor for the Rope class. Deletes the root node of the rope.
+ * Destructor for the Rope class. When no other rope shares the arena, every node in it
+ * belongs to this rope and the arena releases the whole tree at once without walking it.
+ * Otherwise only the references held by this rope are dropped.
  *
  * @param None
  *
@@ -86,545 +81,1870 @@ Rope::Rope() : root(nullptr) { adjustParameters(0); }
  */
 Rope::~Rope()
 {
-    delete root;
+    if (arena.use_count() > 1) {
+        releaseTree(root);
+    }
+    root = nullptr;
+}
+
+/**
+ * Destroys a rope without waiting for its memory to be released. When the rope owns its
+ * arena alone, the arena holds nothing but its tree, so the rope gives it up in O(1) and the
+ * slabs are freed on a worker thread. A rope sharing its arena with copies only drops its
+ * references, which cannot be done on another thread while the copies are being edited.
+ *
+ * @param rope The rope, allocated with new. It is deleted, may be nullptr.
+ *
+ * @return void
+ *
+ * @throws std::system_error if the worker thread cannot be started.
+ */
+void Rope::reclaim(Rope* rope)
+{
+    if (rope == nullptr) return;
+
+    if (rope->arena.use_count() == 1) {
+        rope->resetCursors();
+        rope->root = nullptr;
+        Reclaimer::instance().push(std::move(rope->arena));
+    }
+
+    delete rope;
+}
+
+/**
+ * Blocks until every rope handed to reclaim() has released its memory.
+ *
+ * @return void
+ *
+ * @throws std::system_error if the worker thread cannot be started.
+ */
+void Rope::waitForReclaim()
+{
+    Reclaimer::instance().wait();
 }
 
 /*
-* ROPE MANUPULATION FUNCTIONS
-* ===========================
-* The following functions are used to manipulate the rope data structure.
-* They are used to perform various operations on the rope data structure.
-* The functions are used in the Rope class.
-* The functions are defined below:
-* - merge
-* - split
+* ROPE MEMORY FUNCTIONS
+* =====================
+* Nodes and leaf buffers are allocated from the rope's Arena instead of the global heap.
+* Nodes discarded by an edit are handed back to the arena so the next edit reuses them.
+* - createLeaf
+* - createView
+* - createSlice
+* - createNode
+* - destroyNode
 */
 
 /**
- * Merges two nodes into a new node and returns it. If either of the nodes is null, the non-null node is returned.
- * Updates the weight and height of the new node and performs rebalancing if the height difference between the subtrees exceeds a certain threshold.
+ * Creates a new leaf node in the arena holding a copy of the given string.
+ * Strings of up to Node::INLINE_SIZE bytes are stored in the node itself, without a buffer.
  *
- * @param left The left node to be merged.
- * @param right The right node to be merged.
+ * @param str The string to copy into the leaf.
+ * @param len The length of the string.
  *
- * @return A new node that is the result of merging the left and right nodes.
+ * @return The new leaf node.
  *
- * @throws None.
+ * @throws std::bad_alloc if the arena cannot grow.
  */
-Rope::Node* Rope::merge(Node* left, Node* right)
+Rope::Node* Rope::createLeaf(const char str[], uint32_t len)
 {
-    
-    
+    if (len > 0 && len <= Node::INLINE_SIZE) {
+        return new (arena->allocateNode()) Node(str, len, Node::Storage::Inline);
+    }
 
-    if (left == nullptr)    {return right;}
+    Buffer* buffer = nullptr;
 
-    if (right == nullptr)   {return left;}
-    
-    Node* newNode = new Node(left, right);
-    
+    if (len > 0) {
+        buffer = arena->createBuffer(len);
+        memcpy(buffer->text(), str, len);
+    }
 
-    newNode->updateWeight();
-    newNode->updateHeight();
+    return new (arena->allocateNode()) Node(buffer, 0, len);
+}
 
-    
-    
-    if (abs(int(left->getHeight() - right->getHeight())) > 1) {
-        //rebalancing - Balancing is only performed when the height difference between subtrees exceeds a certain threshold, reducing unnecessary balancing operations.
-        
-        newNode = rebalance(newNode);
+/**
+ * Creates a new leaf node viewing text in a file mapped by the arena. No text is copied.
+ * A Mapped leaf counts its text right away, a Paged leaf leaves it unread.
+ *
+ * @param str The text, inside one of the arena's mappings.
+ * @param len The length of the text.
+ * @param pager The pager of a lazily loaded file, or nullptr for a file opened with LoadMode::Map.
+ *
+ * @return The new leaf node.
+ *
+ * @throws std::bad_alloc if the arena cannot grow.
+ */
+Rope::Node* Rope::createView(const char str[], uint32_t len, Pager* pager)
+{
+    if (pager != nullptr) {
+        return new (arena->allocateNode()) Node(str, len, pager);
     }
 
-    
-    return newNode;
+    return new (arena->allocateNode()) Node(str, len, Node::Storage::Mapped);
 }
 
 /**
- * Splits a given node at a specified position.
+ * Creates a new leaf node sharing part of another leaf's buffer, or viewing part of the same
+ * mapping. No text is copied, except for slices short enough to be stored inline, which would
+ * not save anything by sharing.
  *
- * @param node The node to be split.
- * @param pos The position at which the split should occur.
+ * @param leaf The leaf to slice.
+ * @param start The position of the slice in the leaf.
+ * @param len The length of the slice.
  *
- * @return A pair of nodes where the first node contains the elements before the split position and the second node contains the elements after the split position. If the split position is 0, the first node is null and the second node contains the entire original node. If the split position is greater than or equal to the length of the node, the first node contains the entire original node and the second node is null.
+ * @return The new leaf node.
  *
- * @throws None.
+ * @throws std::bad_alloc if the arena cannot grow.
  */
-std::pair<Rope::Node*, Rope::Node*> Rope::split(Node* node, uint32_t pos)
+Rope::Node* Rope::createSlice(const Node* leaf, uint32_t start, uint32_t len)
 {
-    if (node == nullptr) {
-        return {nullptr, nullptr};
+    if (len > 0 && len <= Node::INLINE_SIZE) {
+        return createLeaf(leaf->getData() + start, len);
+    }
+
+    if (leaf->getIsMapped()) {
+        return createView(leaf->getData() + start, len, leaf->getPager());
     }
 
+    arena->retain(leaf->getBuffer());
+
+    return new (arena->allocateNode()) Node(leaf->getBuffer(), leaf->getOffset() + start, len);
+}
+
+/**
+ * Creates a new internal node in the arena with the given children.
+ *
+ * @param left The left child node.
+ * @param right The right child node.
+ *
+ * @return The new internal node.
+ *
+ * @throws std::bad_alloc if the arena cannot grow.
+ */
+Rope::Node* Rope::createNode(Node* left, Node* right)
+{
+    return new (arena->allocateNode()) Node(left, right);
+}
+
+/**
+ * Returns a single node to the arena, releasing its buffer if it is a leaf. Children are left untouched.
+ *
+ * @param node The node to destroy.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::destroyNode(Node* node)
+{
+    if (node == nullptr) return;
+
     if (node->getIsLeaf()) {
-        
-        uint32_t len = node->getLength();
-        if (pos == 0) {
-            
-            return {nullptr, node};
-        }
-        else if (pos >= len) {
-            
-            return {node, nullptr};
-        }
-        else {
-            char* data = node->getData();
-            Node* left = new Node(data, pos);
-            Node* right = new Node(data + pos, len - pos);
-            
-            return {left, right};
+        arena->release(node->getBuffer());
+    }
+
+    arena->freeNode(node);
+}
+
+/*
+* ROPE SHARING FUNCTIONS
+* ======================
+* Nodes are reference counted and shared between ropes (and between versions of one
+* rope), so copying a rope is O(1). Every tree function takes over the references to
+* the trees it is given and returns references it owns. A node is only modified in place
+* while it has a single reference, shared nodes are copied first (path copying), so an
+* edit allocates O(log n) new nodes and never changes what another rope sees.
+* - retain
+* - releaseTree
+* - makeUnique
+* - takeChildren
+* - shareTree
+*/
+
+/**
+ * Adds a reference to a subtree.
+ *
+ * @param node The root of the subtree, may be nullptr.
+ *
+ * @return The same node.
+ *
+ * @throws None
+ */
+Rope::Node* Rope::retain(Node* node)
+{
+    if (node != nullptr) {
+        node->retain();
+    }
+    return node;
+}
+
+/**
+ * Drops a reference to a subtree. Nodes left without references are returned to the
+ * arena and their children released in turn, shared nodes stay alive for their other owners.
+ *
+ * @param node The root of the subtree, may be nullptr.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::releaseTree(Node* node)
+{
+    stack<Node*> nodeStack;
+    nodeStack.push(node);
+
+    while (!nodeStack.empty()) {
+        Node* currNode = nodeStack.top();
+        nodeStack.pop();
+
+        if (currNode == nullptr || currNode->release() > 0) { continue; }
+
+        if (!currNode->getIsLeaf()) {
+            nodeStack.push(currNode->getLeft());
+            nodeStack.push(currNode->getRight());
         }
+
+        destroyNode(currNode);
+    }
+}
+
+/**
+ * Returns a node that may be modified in place. A shared node is copied (sharing its
+ * children or its buffer) and the reference to the original is dropped.
+ *
+ * @param node The node to make unique, the caller owns one reference to it.
+ *
+ * @return The node itself if it was not shared, otherwise the new copy.
+ *
+ * @throws None
+ */
+Rope::Node* Rope::makeUnique(Node* node)
+{
+    if (node == nullptr || node->getRefs() == 1) {
+        return node;
+    }
+
+    Node* copy;
+    if (node->getIsLeaf()) {
+        copy = createSlice(node, 0, node->getLength());
     }
     else {
-        
-        uint32_t leftWeight = node->getLeft()->getWeight();
-        
-        if (pos <= leftWeight) {
-            
-            auto [left, right] = split(node->getLeft(), pos);
-            
-            
-            return {left, merge(right, node->getRight())};
-        }
-        else {
-            
-            auto [left, right] = split(node->getRight(), pos - leftWeight);
-            
-            
-            return {merge(node->getLeft(), left), right};
-        }
+        copy = createNode(retain(node->getLeft()), retain(node->getRight()));
+    }
+
+    node->release();
+    return copy;
+}
+
+/**
+ * Takes an internal node apart. The node is destroyed when this was its last reference,
+ * otherwise it is left untouched for its other owners and its children are retained.
+ *
+ * @param node The internal node, the caller owns one reference to it.
+ *
+ * @return The left and right children, each with a reference owned by the caller.
+ *
+ * @throws None
+ */
+std::pair<Rope::Node*, Rope::Node*> Rope::takeChildren(Node* node)
+{
+    Node* left = node->getLeft();
+    Node* right = node->getRight();
+
+    if (node->getRefs() == 1) {
+        destroyNode(node);
+    }
+    else {
+        retain(left);
+        retain(right);
+        node->release();
+    }
+
+    return {left, right};
+}
+
+/**
+ * Gets a reference to another rope's tree that can be linked into this one.
+ * Ropes sharing an arena share the tree in O(1), otherwise it is copied into this rope's arena.
+ *
+ * @param rope The rope whose tree is needed.
+ *
+ * @return A tree owned by the caller.
+ *
+ * @throws None
+ */
+Rope::Node* Rope::shareTree(const Rope& rope)
+{
+    if (rope.arena == arena) {
+        return retain(rope.root);
     }
+    return copyNode(rope.root);
 }
 
 /*
-* ROPE BALANCING FUNCTIONS
-* ========================
-* These functions are used to perform balancing operations on the Rope data structure.
-* - rotateLeft
-* - rotateRight
-* - rebalance
+* ROPE CONSTRUCTION FUNCTIONS
+* ===========================
+* Text is turned into a tree bottom-up: the chunks become leaves first and the
+* leaves are paired into a perfectly balanced tree in a single linear pass,
+* instead of merging (and rebalancing) once per chunk.
+* - buildTree
+* - buildBalanced
+* - buildPages
+* - readTree
 */
 
 /**
- * Rebalances the given node in the Rope data structure.
+ * Builds a balanced subtree holding the given text.
  *
- * @param node The node to be rebalanced.
+ * @param str The text to store.
+ * @param len The length of the text.
+ * @param view Whether the leaves view the text in place, which must then lie in one of the
+ *             arena's mappings, instead of copying it.
  *
- * @return The rebalanced node.
+ * @return The root of the new subtree, or nullptr if the text is empty.
  *
- * @throws None.
+ * @throws None
  */
-Rope::Node* Rope::rebalance(Node* node)
+Rope::Node* Rope::buildTree(const char str[], Size len, bool view)
 {
-    if (node == nullptr || node->getIsLeaf()) return node;
-    if (node->getLeft() == nullptr || node->getRight() == nullptr) return node;
-    if (node->getLeft()->getIsLeaf() && node->getRight()->getIsLeaf()) return node;
+    vector<uint32_t> chunks = splitTextIntoChunks(str, len);
 
-    int balance = node->balanceFactor();
-    if (balance <= 1 && balance >= -1) return node; // Lazy-Balancing - No need to rebalance everytime
+    vector<Node*> leaves;
+    leaves.reserve(chunks.size());
 
-    Node *left = node->getLeft();
-    Node *right = node->getRight();
-    
-    if (balance > 1) { // Left heavy
-        if (left->balanceFactor() < 0)
-            node->setLeft(rotateLeft(left));
+    for (uint32_t chunkLength : chunks) {
+        // Copied straight from the source text, or viewed in place
+        leaves.push_back(view ? createView(str, chunkLength) : createLeaf(str, chunkLength));
+        str += chunkLength;
+    }
 
-        
-        node = rotateRight(node);
-        
+    return buildBalanced(leaves, 0, leaves.size());
+}
+
+/**
+ * Builds a balanced subtree over a run of leaves by splitting the run in half.
+ * Both halves differ by at most one leaf, so sibling heights differ by at most one.
+ *
+ * @param leaves The leaves in text order.
+ * @param begin Index of the first leaf of the run.
+ * @param end Index one past the last leaf of the run.
+ *
+ * @return The root of the new subtree, or nullptr if the run is empty.
+ *
+ * @throws None
+ */
+Rope::Node* Rope::buildBalanced(const vector<Node*>& leaves, size_t begin, size_t end)
+{
+    if (begin >= end) {
+        return nullptr;
     }
-    else if (balance < -1) { // Right heavy
-        if (right->balanceFactor() > 0)
-            node->setRight(rotateRight(right));
 
-        
-        node = rotateLeft(node);
-        
+    if (end - begin == 1) {
+        return leaves[begin];
     }
 
-    node->setLeft(rebalance(node->getLeft()));
-    node->setRight(rebalance(node->getRight()));
-    
+    size_t mid = begin + (end - begin) / 2;
 
-    node->updateHeight();
-    node->updateWeight();
+    return createNode(buildBalanced(leaves, begin, mid), buildBalanced(leaves, mid, end));
+}
 
-    
+/**
+ * Builds the skeleton of a lazily loaded file: a balanced subtree of Paged leaves, one per
+ * page of the pager, without reading a byte of the text. Pages are cut at fixed offsets,
+ * so a leaf may end inside a line or a UTF-8 sequence, which the counts already allow.
+ *
+ * @param str The first byte of the mapping.
+ * @param len The length of the mapping.
+ * @param pager The pager of the file.
+ *
+ * @return The root of the new subtree, or nullptr if the file is empty.
+ *
+ * @throws std::bad_alloc if the arena cannot grow.
+ */
+Rope::Node* Rope::buildPages(const char str[], Size len, Pager* pager)
+{
+    vector<Node*> leaves;
+    leaves.reserve(size_t(len / Pager::PAGE_SIZE) + 1);
 
-    return node;
+    for (Size start = 0; start < len; start += Pager::PAGE_SIZE) {
+        leaves.push_back(createView(str + start, uint32_t(min<Size>(Pager::PAGE_SIZE, len - start)), pager));
+    }
+
+    return buildBalanced(leaves, 0, leaves.size());
 }
 
 /**
- * Rotates the given node to the left in the Rope data structure.
+ * Builds a balanced subtree from the rest of a stream, reading it in blocks of up to
+ * LOAD_BLOCK_SIZE bytes. Every byte is kept as it is, CR, LF and NUL included. The chunks
+ * of a block become leaves as soon as it is read, except the last one, which moves to the
+ * front of the next block so that no leaf ends where a block happens to end. Only one block
+ * is held besides the leaves, which are paired up once at the end.
  *
- * @param node The node to be rotated to the left.
+ * @param in The stream, opened in binary mode.
+ * @param length The number of bytes left in the stream, small files get a small block.
  *
- * @return The new root node after the rotation.
+ * @return The root of the new subtree, or nullptr if the stream is empty.
  *
- * @throws None.
+ * @throws std::bad_alloc if the arena cannot grow.
  */
-Rope::Node* Rope::rotateLeft(Node* node)
+Rope::Node* Rope::readTree(istream& in, uint64_t length)
 {
-    Node* newRoot = node->getRight();
-    node->setRight(newRoot->getLeft());
-    newRoot->setLeft(node);
-    node->updateHeight();
-    newRoot->updateHeight();
-    return newRoot;
+    size_t blockSize = size_t(min<uint64_t>(length, LOAD_BLOCK_SIZE)) + 1; // One more byte to see the end without another read
+    unique_ptr<char[]> block(new char[blockSize + maxLeafSize]); // Room for a block after the carried chunk
+
+    vector<Node*> leaves;
+    leaves.reserve(size_t(length / chunkSize) + 1);
+    size_t carried = 0;
+
+    while (true) {
+        in.read(block.get() + carried, blockSize);
+        size_t filled = carried + size_t(in.gcount());
+        bool last = !in; // A short read means the end of the file
+
+        vector<uint32_t> chunks = splitTextIntoChunks(block.get(), Size(filled));
+        size_t complete = last || chunks.empty() ? chunks.size() : chunks.size() - 1;
+
+        const char* str = block.get();
+        for (size_t i = 0; i < complete; i++) {
+            leaves.push_back(createLeaf(str, chunks[i]));
+            str += chunks[i];
+        }
+
+        if (last) break;
+
+        carried = filled - size_t(str - block.get());
+        memmove(block.get(), str, carried);
+    }
+
+    return buildBalanced(leaves, 0, leaves.size());
+}
+
+/*
+* ROPE MANUPULATION FUNCTIONS
+* ===========================
+* The following functions are used to manipulate the rope data structure.
+* They are used to perform various operations on the rope data structure.
+* The functions are used in the Rope class.
+* The functions are defined below:
+* - merge
+* - split
+*/
+
+/**
+ * Joins two trees, every position of the left one coming before the right one (AVL join).
+ * When the heights differ by more than one, the join descends the inner spine of the taller
+ * tree to a subtree at most one level taller than the other tree, links the two there and
+ * rebalances each node on the way back up with at most one single or double rotation.
+ * The result is an AVL tree of height max(hl, hr) or one more, built in O(|hl - hr| + 1).
+ *
+ * @param left The tree holding the beginning of the text, may be nullptr.
+ * @param right The tree holding the end of the text, may be nullptr.
+ *
+ * @return The root of the joined tree.
+ *
+ * @throws None.
+ */
+Rope::Node* Rope::merge(Node* left, Node* right)
+{
+    if (left == nullptr)    {return right;}
+
+    if (right == nullptr)   {return left;}
+
+    uint32_t leftHeight = left->getHeight();
+    uint32_t rightHeight = right->getHeight();
+
+    if (leftHeight > rightHeight + 1) { // Join along the right spine of the left tree
+        Node* node = makeUnique(left);
+        node->setRight(merge(node->getRight(), right));
+        node->updateWeight();
+        node->updateHeight();
+
+        return rebalance(node);
+    }
+
+    if (rightHeight > leftHeight + 1) { // Join along the left spine of the right tree
+        Node* node = makeUnique(right);
+        node->setLeft(merge(left, node->getLeft()));
+        node->updateWeight();
+        node->updateHeight();
+
+        return rebalance(node);
+    }
+
+    return createNode(left, right);
+}
+
+/**
+ * Concatenates two trees like merge(), and coalesces the two leaves that meet at the seam
+ * when either of them is below minLeafSize and together they still fit in maxLeafSize.
+ * This keeps remove() and split() from leaving runs of tiny leaves behind.
+ *
+ * @param left The tree holding the beginning of the text.
+ * @param right The tree holding the end of the text.
+ *
+ * @return The root of the concatenated tree.
+ *
+ * @throws None.
+ */
+Rope::Node* Rope::concat(Node* left, Node* right)
+{
+    if (left == nullptr)    {return right;}
+
+    if (right == nullptr)   {return left;}
+
+    uint32_t leftLength = rightmostLeaf(left)->getLength();
+    uint32_t rightLength = leftmostLeaf(right)->getLength();
+
+    if ((leftLength >= minLeafSize && rightLength >= minLeafSize) || leftLength + rightLength > maxLeafSize) {
+        return merge(left, right);
+    }
+
+    auto [leftRest, leftLeaf] = split(left, left->getWeight() - leftLength);
+    auto [rightLeaf, rightRest] = split(right, rightLength);
+
+    uint32_t len = leftLength + rightLength;
+    Node* leaf;
+
+    if (len <= Node::INLINE_SIZE) { // Short enough to live in the node, without a buffer
+        char text[Node::INLINE_SIZE];
+        memcpy(text, leftLeaf->getData(), leftLength);
+        memcpy(text + leftLength, rightLeaf->getData(), rightLength);
+        leaf = createLeaf(text, len);
+    }
+    else {
+        Buffer* buffer = arena->createBuffer(len);
+        memcpy(buffer->text(), leftLeaf->getData(), leftLength);
+        memcpy(buffer->text() + leftLength, rightLeaf->getData(), rightLength);
+        leaf = new (arena->allocateNode()) Node(buffer, 0, len);
+    }
+
+    releaseTree(leftLeaf);
+    releaseTree(rightLeaf);
+
+    return merge(merge(leftRest, leaf), rightRest);
+}
+
+/**
+ * Finds the first leaf of a tree.
+ *
+ * @param node The root of the tree.
+ *
+ * @return The leftmost leaf.
+ *
+ * @throws None.
+ */
+Rope::Node* Rope::leftmostLeaf(Node* node)
+{
+    while (!node->getIsLeaf()) {
+        node = node->getLeft();
+    }
+    return node;
+}
+
+/**
+ * Finds the last leaf of a tree.
+ *
+ * @param node The root of the tree.
+ *
+ * @return The rightmost leaf.
+ *
+ * @throws None.
+ */
+Rope::Node* Rope::rightmostLeaf(Node* node)
+{
+    while (!node->getIsLeaf()) {
+        node = node->getRight();
+    }
+    return node;
+}
+
+/**
+ * Splits a given node at a specified position.
+ *
+ * @param node The node to be split.
+ * @param pos The position at which the split should occur.
+ *
+ * @return A pair of nodes where the first node contains the elements before the split position and the second node contains the elements after the split position. If the split position is 0, the first node is null and the second node contains the entire original node. If the split position is greater than or equal to the length of the node, the first node contains the entire original node and the second node is null.
+ *
+ * @throws None.
+ */
+std::pair<Rope::Node*, Rope::Node*> Rope::split(Node* node, Size pos)
+{
+    if (node == nullptr) {
+        return {nullptr, nullptr};
+    }
+
+    if (node->getIsLeaf()) {
+        
+        uint32_t len = node->getLength();
+        if (pos == 0) {
+            
+            return {nullptr, node};
+        }
+        else if (pos >= len) {
+            
+            return {node, nullptr};
+        }
+        else {
+            Node* left = createSlice(node, 0, pos);
+            Node* right = createSlice(node, pos, len - pos);
+
+            releaseTree(node);
+            
+            return {left, right};
+        }
+    }
+    else {
+        
+        // The split rebuilds its own parents with merge(), this one is no longer needed.
+        // Each merge costs the height difference of its inputs, which add up to O(log n) over the path
+        auto [leftChild, rightChild] = takeChildren(node);
+        Size leftWeight = leftChild->getWeight();
+        
+        if (pos <= leftWeight) {
+            
+            auto [left, right] = split(leftChild, pos);
+            
+            
+            return {left, merge(right, rightChild)};
+        }
+        else {
+            
+            auto [left, right] = split(rightChild, pos - leftWeight);
+            
+            
+            return {merge(leftChild, left), right};
+        }
+    }
+}
+
+/*
+* ROPE BALANCING FUNCTIONS
+* ========================
+* The tree is kept an AVL tree: the heights of the two children of a node differ by at most
+* one, so the height stays under 1.44 log2(leaves). merge() is the only place heights can
+* drift, and it repairs them one node at a time on its way back up.
+* - rotateLeft
+* - rotateRight
+* - rebalance
+*/
+
+/**
+ * Restores the AVL balance of a node whose children differ in height by two, with a single
+ * or a double rotation. The children must be balanced already, nothing below them is visited.
+ *
+ * @param node The node to be rebalanced.
+ *
+ * @return The root of the rebalanced subtree.
+ *
+ * @throws None.
+ */
+Rope::Node* Rope::rebalance(Node* node)
+{
+    if (node == nullptr || node->getIsLeaf()) return node;
+
+    int balance = node->balanceFactor();
+    if (balance <= 1 && balance >= -1) return node;
+
+    node = makeUnique(node); // Shared nodes are copied before their children are replaced
+
+    if (balance > 1) { // Left heavy
+        if (node->getLeft()->balanceFactor() < 0) {
+            node->setLeft(rotateLeft(node->getLeft()));
+        }
+        node = rotateRight(node);
+    }
+    else { // Right heavy
+        if (node->getRight()->balanceFactor() > 0) {
+            node->setRight(rotateRight(node->getRight()));
+        }
+        node = rotateLeft(node);
+    }
+
+    return node;
+}
+
+/**
+ * Rotates the given node to the left in the Rope data structure.
+ *
+ * @param node The node to be rotated to the left.
+ *
+ * @return The new root node after the rotation.
+ *
+ * @throws None.
+ */
+Rope::Node* Rope::rotateLeft(Node* node)
+{
+    node = makeUnique(node);
+    Node* newRoot = makeUnique(node->getRight());
+    node->setRight(newRoot->getLeft());
+    newRoot->setLeft(node);
+
+    node->updateWeight();
+    node->updateHeight();
+    newRoot->updateWeight();
+    newRoot->updateHeight();
+
+    return newRoot;
+}
+
+/**
+ * Rotates the given node to the right in the Rope data structure.
+ *
+ * @param node The node to be rotated to the right.
+ *
+ * @return The new root node after the rotation.
+ *
+ * @throws None.
+ */
+Rope::Node* Rope::rotateRight(Node* node)
+{
+    node = makeUnique(node);
+    Node* newRoot = makeUnique(node->getLeft());
+    node->setLeft(newRoot->getRight());
+    newRoot->setRight(node);
+
+    node->updateWeight();
+    node->updateHeight();
+    newRoot->updateWeight();
+    newRoot->updateHeight();
+
+    return newRoot;
+}
+
+
+/*
+* ROPE FINGER FUNCTIONS
+* =====================
+* Typing produces long runs of small edits at nearly the same position. The rope keeps a
+* finger on the leaf of the last edit, and an edit that fits in that leaf changes its bytes
+* in place and adds the change to the weights on the path. Leaf buffers have slack (the rest
+* of their size class, and more for leaves that have been edited), so most keystrokes
+* only move the bytes after the cursor. No node is split, merged or rebalanced, and the
+* finger stays valid for the next keystroke. Edits that cross a leaf boundary, overflow
+* maxLeafSize, shrink a leaf under minLeafSize or touch nodes shared with another rope
+* take the split/concat path and drop the finger.
+* - seekFinger
+* - editLeaf
+*/
+
+/**
+ * Moves the finger to the leaf holding a position, unless it is there already.
+ *
+ * @param pos The position, a position between two leaves may use either of them.
+ *
+ * @return true if the finger is on a leaf holding pos whose path is not shared, false otherwise.
+ *
+ * @throws None
+ */
+bool Rope::seekFinger(Size pos)
+{
+    if (finger.leaf != nullptr && pos >= finger.start && pos - finger.start <= finger.leaf->getLength()) {
+        // A copy of the rope made since the last edit shares the path, it must not change under it
+        bool unique = finger.leaf->getRefs() == 1;
+        for (size_t i = 0; unique && i < finger.path.size(); i++) {
+            unique = finger.path[i]->getRefs() == 1;
+        }
+        if (unique) return true;
+    }
+
+    finger.leaf = nullptr;
+    finger.path.clear();
+
+    Node* node = root;
+    Size offset = pos;
+
+    while (node->getRefs() == 1 && !node->getIsLeaf()) {
+        finger.path.push_back(node);
+
+        Node* left = node->getLeft();
+        if (offset >= left->getWeight()) {
+            offset -= left->getWeight();
+            node = node->getRight();
+        }
+        else {
+            node = left;
+        }
+    }
+
+    if (node->getRefs() != 1 || offset > node->getLength()) return false; // Shared with another rope, or past the end
+
+    finger.leaf = node;
+    finger.start = pos - offset;
+    return true;
+}
+
+/**
+ * Replaces a range of the rope with a string by editing the leaf under the finger,
+ * when the range and the result both fit in that leaf.
+ *
+ * @param pos The position of the range.
+ * @param removed The length of the range to remove.
+ * @param str The string to insert in its place.
+ * @param len The length of the string.
+ *
+ * @return true if the edit was applied, false if it has to go through split/concat.
+ *
+ * @throws std::bad_alloc if the arena cannot grow.
+ */
+bool Rope::editLeaf(Size pos, Size removed, const char str[], Size len)
+{
+    if (root == nullptr || len > maxLeafSize || !seekFinger(pos)) return false;
+
+    Node* leaf = finger.leaf;
+    uint32_t at = uint32_t(pos - finger.start);
+    uint32_t length = leaf->getLength();
+
+    if (removed > length - at) return false; // The range continues in the next leaf
+
+    uint32_t newLength = length - uint32_t(removed) + uint32_t(len);
+
+    // Overflow splits the leaf, and shrinking under minLeafSize lets concat() merge it with a neighbour
+    if (newLength > maxLeafSize || newLength == 0 || (newLength < minLeafSize && newLength < length && root != leaf)) {
+        return false;
+    }
+
+    // A leaf moved to a new buffer keeps half its length spare, up to maxLeafSize, for the next keystrokes
+    uint32_t slack = min(newLength / 2, maxLeafSize - newLength);
+
+    leaf->editText(*arena, at, uint32_t(removed), str, uint32_t(len), slack);
+
+    // Heights are unchanged, only the weights and counts along the path move
+    for (auto it = finger.path.rbegin(); it != finger.path.rend(); ++it) {
+        (*it)->updateWeight();
+    }
+
+    lastLeaf.seek(nullptr, 0);
+
+    return true;
+}
+
+/*
+ * Rope Functions
+ * ==============
+ * These functions are used to perform various operations on the Rope data structure.
+ * They are implemented as member functions of the Rope class.
+*/
+
+/**
+ * Appends the given rope to the end of this rope.
+ *
+ * @param rope The rope to append to this rope.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::append(const Rope& rope)
+{
+    resetCursors();
+    Node* newRoot = merge(root, shareTree(rope));
+    root = newRoot;
+}
+
+/**
+ * Appends a new node containing the given string and length to the end of the rope.
+ * Appends are made for growing logs: the text first fills the rightmost leaf up to
+ * maxLeafSize through the finger, in place once the leaf has moved to a full-size buffer.
+ * Only what does not fit is built into new leaves and joined down the right spine, about
+ * once every maxLeafSize bytes, so the splitting, allocation and rebalancing are amortized
+ * O(1) per append. The leaf size also follows the rope up the size tiers as it grows.
+ *
+ * @param str The string to append.
+ * @param len The length of the string.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::append(const char str[], Size len)
+{
+    if (len == 0) return;
+
+    Size length = getLength();
+
+    uint32_t currChunkSize = chunkSize;
+    adjustParameters(length + len);
+    if (chunkSize < currChunkSize) { // Tiers only go up, a rope built small keeps its leaves
+        setChunkSize(currChunkSize);
+    }
+
+    if (root != nullptr && seekFinger(length)) {
+        Node* leaf = finger.leaf;
+        uint32_t leafLength = leaf->getLength();
+        uint32_t fill = uint32_t(min<Size>(len, leafLength < maxLeafSize ? maxLeafSize - leafLength : 0));
+
+        // Do not split a UTF-8 sequence between the tail leaf and the next one
+        while (fill > 0 && fill < len && (str[fill] & 0xC0) == 0x80) {
+            fill--;
+        }
+
+        if (fill > 0) {
+            // The tail only grows, so it gets a buffer for a whole leaf the first time it moves
+            leaf->editText(*arena, leafLength, 0, str, fill, maxLeafSize - leafLength - fill);
+
+            for (auto it = finger.path.rbegin(); it != finger.path.rend(); ++it) {
+                (*it)->updateWeight();
+            }
+
+            lastLeaf.seek(nullptr, 0);
+
+            str += fill;
+            len -= fill;
+        }
+
+        if (len == 0) return;
+    }
+
+    resetCursors();
+    root = merge(root, buildTree(str, len));
+}
+
+/**
+ * Prepends the given rope to the beginning of this rope.
+ *
+ * @param rope The rope to prepend to this rope.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::prepend(const Rope& rope)
+{
+    resetCursors();
+    root = merge(shareTree(rope), root);
+}
+
+/**
+ * Prepends a new node containing the given string and length to the beginning of the rope.
+ *
+ * @param str The string to prepend.
+ * @param len The length of the string.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::prepend(const char str[], Size len)
+{
+    resetCursors();
+    root = merge(buildTree(str, len), root);
+}
+
+/**
+ * Inserts a new string at the specified position in the rope.
+ * Small edits near the finger are done in the leaf, anything else costs one split and two
+ * joins whatever the length of the string, plus building its leaves.
+ *
+ * @param pos The position at which the string should be inserted.
+ * @param str The string to be inserted.
+ * @param len The length of the string.
+ *
+ * @throws None
+ */
+void Rope::insert(Size pos, const char str[], Size len)
+{
+    if (editLeaf(pos, 0, str, len)) return;
+
+    resetCursors();
+
+    if (len == 0) return;
+
+    // Build the whole text as one balanced subtree, then split the rope once and join the three parts
+    Node* middle = buildTree(str, len);
+
+    if (pos == 0) {
+        root = merge(middle, root);
+        return;
+    }
+
+    if (pos >= getLength()) {
+        root = merge(root, middle);
+        return;
+    }
+
+    auto [left, right] = split(root, pos);
+    root = concat(concat(left, middle), right);
+}
+
+/**
+ * Inserts a rope at the specified position in the rope.
+ *
+ * @param pos The position at which the rope should be inserted.
+ * @param rope The rope to be inserted.
+ *
+ * @return None
+ *
+ * @throws None
+ */
+void Rope::insert(Size pos, const Rope& rope)
+{
+    if (pos == 0) { // Prepend
+        prepend(rope);
+        return;
+    }
+
+    if (pos >= getLength()) { // Append
+        append(rope);
+        return;
+    }
+
+    
+    resetCursors();
+    auto splitResult = split(root, pos);
+    
+
+    Node* leftSubtree = concat(splitResult.first, shareTree(rope));
+    root = concat(leftSubtree , splitResult.second);
+}
+
+/**
+ * Removes a character at the specified position from the rope.
+ *
+ * @param pos The position of the character to be removed.
+ *
+ * @throws None
+ */
+void Rope::remove(Size pos)
+{
+    remove(pos, 1);
+}
+
+/**
+ * Removes a range of characters from the rope starting from 'start' position to 'end' position.
+ *
+ * @param start The starting position of the range to be removed.
+ * @param end The ending position of the range to be removed.
+ *
+ * @return None
+ *
+ * @throws None
+ */
+void Rope::remove(Size start, Size length)
+{
+    if (length > 0 && editLeaf(start, length, nullptr, 0)) return;
+
+    resetCursors();
+    auto splitStart = split(root, start);
+    
+    if (splitStart.second == nullptr) {
+        root = splitStart.first;
+        
+        return;
+    }
+
+
+    auto splitEnd = split(splitStart.second, length);
+    
+    releaseTree(splitEnd.first); // Removed text goes back to the arena
+
+    root = concat(splitStart.first, splitEnd.second);
+    
+}
+
+
+/**
+ * Applies a batch of edits in one pass down the tree. Each node hands its edits to the child
+ * they fall in, an edit crossing the boundary between the children is cut in two, and
+ * subtrees without edits are kept as they are (shared, not copied). Only the leaves under an
+ * edit are rebuilt, and the new children are joined back on the way up. Positions refer to
+ * the text before the batch, so callers do not shift them, and k edits cost O(k log(n / k))
+ * node visits plus rebuilding the edited leaves.
+ *
+ * @param edits The edits, sorted by position. An edit may not start before the end of
+ *              the range removed by the previous one.
+ *
+ * @return void
+ *
+ * @throws std::invalid_argument if the edits are not sorted or their ranges overlap.
+ */
+void Rope::applyEdits(const vector<Edit>& edits)
+{
+    for (size_t i = 1; i < edits.size(); i++) {
+        if (edits[i].pos < edits[i - 1].pos + edits[i - 1].removed) {
+            throw invalid_argument("Rope::applyEdits: edits must be sorted and must not overlap");
+        }
+    }
+
+    resetCursors();
+
+    root = editTree(root, 0, edits);
+}
+
+/**
+ * Applies sorted edits to a subtree, see applyEdits().
+ *
+ * @param node The subtree, the caller's reference to it is consumed. May be nullptr.
+ * @param offset The position of the subtree in the rope.
+ * @param edits The edits touching the subtree, none of them starts before offset.
+ *
+ * @return The edited subtree, owned by the caller.
+ *
+ * @throws None
+ */
+Rope::Node* Rope::editTree(Node* node, Size offset, const vector<Edit>& edits)
+{
+    if (edits.empty()) return node;
+
+    Size weight = node ? node->getWeight() : 0;
+    const Edit& first = edits.front();
+
+    // One edit covering the whole subtree replaces it without visiting it
+    if (node == nullptr || (edits.size() == 1 && first.pos <= offset && first.pos + first.removed >= offset + weight)) {
+        string text;
+        for (const Edit& edit : edits) {
+            text.append(edit.text);
+        }
+
+        releaseTree(node);
+        return buildTree(text.data(), text.size());
+    }
+
+    if (node->getIsLeaf()) {
+        const char* data = node->getData();
+        uint32_t length = node->getLength();
+
+        string text;
+        text.reserve(length);
+
+        uint32_t kept = 0; // Bytes of the leaf copied or removed so far
+        for (const Edit& edit : edits) {
+            uint32_t pos = uint32_t(min<Size>(edit.pos - offset, length));
+            text.append(data + kept, pos - kept);
+            text.append(edit.text);
+            kept = uint32_t(min<Size>(pos + edit.removed, length));
+        }
+        text.append(data + kept, length - kept);
+
+        releaseTree(node);
+        return buildTree(text.data(), text.size());
+    }
+
+    auto [left, right] = takeChildren(node);
+    Size boundary = offset + left->getWeight();
+
+    vector<Edit> leftEdits, rightEdits;
+    for (const Edit& edit : edits) {
+        if (edit.pos > boundary || (edit.pos == boundary && edit.removed > 0)) {
+            rightEdits.push_back(edit);
+        }
+        else if (edit.pos + edit.removed > boundary) { // Removes text on both sides
+            leftEdits.push_back({edit.pos, boundary - edit.pos, edit.text});
+            rightEdits.push_back({boundary, edit.pos + edit.removed - boundary, string_view()});
+        }
+        else {
+            leftEdits.push_back(edit);
+        }
+    }
+
+    Node* newLeft = editTree(left, offset, leftEdits);
+    Node* newRight = editTree(right, boundary, rightEdits);
+
+    return merge(newLeft, newRight);
+}
+
+/**
+ * Cuts a range of characters from the rope. The rope itself is left unchanged, the
+ * returned rope shares the subtrees of the range with it (see substr()).
+ *
+ * @param start The starting position of the range to be cut.
+ * @param length The number of characters to cut.
+ *
+ * @return A new Rope object containing the cut range of characters.
+ *
+ * @throws None
+ */
+Rope* Rope::cut(Size start, Size length)
+{
+    return new Rope(substr(start, length));
+}
+
+/**
+ * Retrieves a range of the rope as a new rope without modifying this one. The new rope
+ * shares the arena and every subtree fully inside the range, only the O(log n) nodes
+ * along the two split paths are copied, so the cost does not depend on the range size.
+ *
+ * @param pos The position of the first character.
+ * @param len The number of characters, clamped to the end of the rope.
+ *
+ * @return The new rope.
+ *
+ * @throws None
+ */
+Rope Rope::substr(Size pos, Size len) const
+{
+    Rope rope(*this);
+
+    pos = min(pos, getLength());
+    len = min(len, getLength() - pos);
+
+    // Splitting the shared copy path-copies the nodes it walks through, this tree is untouched
+    auto [before, rest] = rope.split(rope.root, pos);
+    auto [range, after] = rope.split(rest, len);
+
+    rope.releaseTree(before);
+    rope.releaseTree(after);
+    rope.root = range;
+
+    return rope;
+}
+
+/**
+ * Copies a range of the rope into a buffer, leaf by leaf, without modifying the tree.
+ *
+ * @param buffer The buffer to copy into, with room for at least `len` characters.
+ * @param pos The position of the first character.
+ * @param len The number of characters, clamped to the end of the rope.
+ *
+ * @return The number of characters copied.
+ *
+ * @throws None
+ */
+Rope::Size Rope::copyTo(char buffer[], Size pos, Size len) const
+{
+    pos = min(pos, getLength());
+    len = min(len, getLength() - pos);
+
+    Size copied = 0;
+    for (ChunkIterator it = chunksAt(pos); copied < len; ++it) {
+        string_view chunk = *it;
+        Size skip = pos + copied - it.getOffset();
+        Size count = min<Size>(chunk.size() - skip, len - copied);
+
+        memcpy(buffer + copied, chunk.data() + skip, count);
+        copied += count;
+    }
+
+    return copied;
+}
+
+/**
+ * Cuts the text between two line/column positions from the rope.
+ * Lines and columns count from 0, a column past the end of its line stops at the line end.
+ *
+ * @param minline The line of the first character to cut.
+ * @param mincol The column of the first character to cut.
+ * @param maxline The line of the position the cut ends before.
+ * @param maxcol The column of the position the cut ends before.
+ *
+ * @return A new Rope object containing the cut range of characters.
+ *
+ * @throws None
+ */
+Rope* Rope::cut(Size minline, Size mincol, Size maxline, Size maxcol)
+{
+    Size start = offsetOfPosition(minline, mincol);
+    Size end = offsetOfPosition(maxline, maxcol);
+
+    return cut(start, end > start ? end - start : 0);
+}
+
+
+/**
+ * Inserts the contents of the given rope `r` at the specified position `pos` in the current rope.
+ *
+ * @param pos The position at which the contents of `r` should be inserted.
+ * @param r The rope whose contents should be inserted.
+ *
+ * @throws None
+ */
+void Rope::paste(Size pos, const Rope* r)
+{
+    insert(pos, *r);
+}
+
+
+
+/**
+ * Loads a file at the end of the rope.
+ * In Read mode the file is read in large blocks straight into the leaves, byte for byte,
+ * so line endings are kept as they are in the file.
+ * In Map mode the file is mapped read-only and the leaves view the mapping, so opening it
+ * costs building the tree and counting its lines, without copying a byte. An edited leaf
+ * moves its text to the heap, the rest keeps viewing the file. The file should not be
+ * changed by other programs while the rope uses it, save() replaces it safely.
+ * In Lazy mode even the counting is left for later: the tree is a skeleton of page-sized
+ * leaves and a page is only read when a read or an edit reaches it, so jumping to the end
+ * of the file reads the last page alone. The first line or character query counts the pages
+ * before the position it needs. Pages read past the budget set with setPageBudget() are
+ * evicted, oldest first.
+ *
+ * @param filename The name of the file.
+ * @param mode How to bring the file in: LoadMode::Read copies it into the rope, LoadMode::Map
+ *             views a read-only mapping of it and LoadMode::Lazy views the mapping a page at a time.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::load(const char filename[], LoadMode mode)
+{
+    if (mode != LoadMode::Read) {
+        uint64_t length = 0;
+        const char* text = arena->mapFile(filename, length);
+
+        if (text == nullptr) {
+            if (!ifstream(filename).is_open()) {
+                cout << "Error opening file" << endl;
+            }
+            return; // Otherwise the file is empty
+        }
+
+        if (length > numeric_limits<Size>::max() - getLength()) {
+            cout << "File is too large, build with ROPE_64BIT to open it" << endl;
+            return;
+        }
+
+        adjustParameters(getLength() + Size(length));
+        resetCursors();
+        if (mode == LoadMode::Lazy) {
+            root = merge(root, buildPages(text, Size(length), arena->createPager(text, length)));
+        }
+        else {
+            root = merge(root, buildTree(text, Size(length), true));
+        }
+        return;
+    }
+
+    ifstream file(filename, ios::binary | ios::ate);
+
+    if (!file.is_open()) {
+        cout << "Error opening file" << endl;
+        return;
+    }
+
+    uint64_t length = uint64_t(file.tellg());
+    if (length > numeric_limits<Size>::max() - getLength()) {
+        cout << "File is too large, build with ROPE_64BIT to open it" << endl;
+        return;
+    }
+    file.seekg(0);
+
+    adjustParameters(getLength() + Size(length));
+    resetCursors();
+    root = merge(root, readTree(file, length));
+    return;
+}
+
+/**
+ * Writes the rope to a file. When leaves may view the file being written, the text goes to
+ * a temporary file that then replaces the target. On POSIX systems the mapping keeps the
+ * old contents for every rope still viewing it. Windows does not replace a mapped file, so
+ * there the leaves viewing it move to the heap and the file is unmapped first.
+ * On failure the target is left as it was and the temporary file is removed.
+ *
+ * @param filename The name of the file.
+ *
+ * @return true if the whole rope was written, false otherwise.
+ *
+ * @throws std::bad_alloc if the text viewing the file cannot be moved to the heap.
+ */
+bool Rope::save(const char filename[])
+{
+    string path = filename;
+    if (arena->mapsFile(filename)) {
+        path += ".tmp";
+    }
+
+    ofstream file (path, ios::binary | ios::trunc); // Byte for byte, a text stream would turn LF into CRLF on Windows
+
+    if (!file.is_open()) {
+        std::cerr << "Error opening file" << std::endl;
+        return false;
+    }
+
+    for (ChunkIterator it = chunksBegin(); it != chunksEnd(); ++it) {
+        string_view chunk = *it;
+        file.write(chunk.data(), chunk.size());
+    }
+    file.close();
+
+    error_code error;
+    if (file.fail()) {
+        std::cerr << "Error writing file" << std::endl;
+        if (path != filename) {
+            filesystem::remove(path, error);
+        }
+        return false;
+    }
+
+    if (path != filename) {
+#ifdef _WIN32
+        arena->unmapFile(filename);
+#endif
+        filesystem::rename(path, filename, error);
+        if (error) {
+            std::cerr << "Error replacing file: " << error.message() << std::endl;
+            filesystem::remove(path, error);
+            return false;
+        }
+    }
+
+    cout << "Data has been written to : " << filename << endl;
+    return true;
+}
+
+/**
+ * Sets how many bytes of each lazily loaded file the rope may keep resident. Pages read past
+ * the budget evict the least recently read ones, which are read again from the file when
+ * needed. The budget is shared with the copies of the rope.
+ *
+ * @param bytes The budget in bytes, the most recently read page always stays.
+ *
+ * @return void
+ *
+ * @throws None
+ */
+void Rope::setPageBudget(size_t bytes)
+{
+    arena->setPageBudget(bytes);
+}
+
+/**
+ * Retrieves how many bytes of lazily loaded files are resident, read and not evicted since.
+ *
+ * @return The number of resident bytes, 0 if no file was loaded with LoadMode::Lazy.
+ */
+size_t Rope::getResidentBytes() const
+{
+    return arena->getResidentBytes();
+}
+
+Rope::Size Rope::getLength() const
+{
+    return root ? root->getWeight() : 0;
+}
+
+/**
+ * Retrieves the height of the rope's tree (0 for a single leaf or an empty rope).
+ *
+ * @return The height of the root node.
+ */
+uint32_t Rope::getHeight() const
+{
+    return root ? root->getHeight() : 0;
+}
+
+/*
+* ROPE LINE FUNCTIONS
+* ===================
+* Every node knows how many newlines its subtree holds, so a line number is found by
+* walking down the tree once and scanning a single leaf, O(log n) instead of a full scan.
+* Lines and columns count from 0, a column is a byte offset into its line.
+* A lazily loaded rope counts its pages on the first query that needs them.
+* - counted
+* - getLineCount
+* - offsetOfLine
+* - lineOfOffset
+* - offsetOfPosition
+* - positionOfOffset
+*/
+
+/**
+ * Makes sure the counts of a subtree are known, reading the Paged leaves in it that have
+ * not been read yet. Subtrees already counted are skipped, so this is O(1) once a lazily
+ * loaded rope has been counted, and always for any other rope.
+ *
+ * @param node The root of the subtree, may be nullptr.
+ *
+ * @return The same node, now counted.
+ *
+ * @throws None
+ */
+const Rope::Node* Rope::counted(const Node* node)
+{
+    if (node == nullptr || node->getIsCounted()) {
+        return node;
+    }
+
+    if (!node->getIsLeaf()) {
+        counted(node->getLeft());
+        counted(node->getRight());
+    }
+
+    const_cast<Node*>(node)->count(); // Fills in a cache, the text is unchanged
+    return node;
+}
+
+/**
+ * Retrieves the number of lines in the rope. An empty rope still has one (empty) line.
+ *
+ * @return The number of newlines plus one.
+ */
+Rope::Size Rope::getLineCount() const
+{
+    return (root ? counted(root)->getLines() : 0) + 1;
+}
+
+/**
+ * Finds where a line starts.
+ *
+ * @param line The line number.
+ *
+ * @return The offset of the first character of the line, or the length of the rope if there is no such line.
+ *
+ * @throws None
+ */
+Rope::Size Rope::offsetOfLine(Size line) const
+{
+    if (line == 0 || root == nullptr) {
+        return 0;
+    }
+
+    // The line starts right after newline number `line`, found without counting the text after it
+    Size index = line - 1;
+    Size offset = 0;
+    const Node* node = findUnit(root, index, offset, Unit::Line);
+
+    if (node == nullptr) {
+        return getLength();
+    }
+
+    const char* data = node->getData();
+    const char* end = data + node->getLength();
+    const char* curr = data;
+
+    for (index++; index > 0; index--) {
+        curr = static_cast<const char*>(memchr(curr, '\n', end - curr)) + 1;
+    }
+
+    return offset + Size(curr - data);
+}
+
+/**
+ * Finds the line a position is on.
+ *
+ * @param pos The position in the rope, positions past the end are clamped to it.
+ *
+ * @return The number of newlines before the position.
+ *
+ * @throws None
+ */
+Rope::Size Rope::lineOfOffset(Size pos) const
+{
+    if (root == nullptr) {
+        return 0;
+    }
+
+    const Node* node = root;
+    Size line = 0;
+
+    while (!node->getIsLeaf()) {
+        const Node* left = node->getLeft();
+
+        if (pos < left->getWeight()) {
+            node = left;
+        }
+        else {
+            line += counted(left)->getLines(); // Only the text before the position is read
+            pos -= left->getWeight();
+            node = node->getRight();
+        }
+    }
+
+    const char* data = node->getData();
+    if (data != nullptr) {
+        line += Size(count(data, data + min<Size>(pos, node->getLength()), '\n'));
+    }
+
+    return line;
+}
+
+/**
+ * Converts a line/column position to an offset in the rope.
+ *
+ * @param line The line number, lines past the last one map to the end of the rope.
+ * @param column The column in the line, columns past the end of the line stop at the line end.
+ *
+ * @return The offset of the position.
+ *
+ * @throws None
+ */
+Rope::Size Rope::offsetOfPosition(Size line, Size column) const
+{
+    Size start = offsetOfLine(line);
+    Size next = offsetOfLine(line + 1);
+    Size end = next > start && (*this)[next - 1] == '\n' ? next - 1 : next; // Excludes the newline
+
+    return start + min(column, end - start);
 }
 
 /**
- * Rotates the given node to the right in the Rope data structure.
+ * Converts an offset in the rope to a line/column position.
  *
- * @param node The node to be rotated to the right.
+ * @param pos The position in the rope, positions past the end are clamped to it.
  *
- * @return The new root node after the rotation.
+ * @return The line and the column of the position.
  *
- * @throws None.
+ * @throws None
  */
-Rope::Node* Rope::rotateRight(Node* node)
+std::pair<Rope::Size, Rope::Size> Rope::positionOfOffset(Size pos) const
 {
-    Node* newRoot = node->getLeft();
-    node->setLeft(newRoot->getRight());
-    newRoot->setRight(node);
-
-    node->updateWeight();
-    node->updateHeight();
-    newRoot->updateWeight();
-    newRoot->updateHeight();
+    pos = min(pos, getLength());
+    Size line = lineOfOffset(pos);
 
-    return newRoot;
+    return {line, pos - offsetOfLine(line)};
 }
 
-
 /*
- * Rope Functions
- * ==============
- * These functions are used to perform various operations on the Rope data structure.
- * They are implemented as member functions of the Rope class.
+* ROPE ENCODING FUNCTIONS
+* =======================
+* The rope is indexed by UTF-8 bytes, Qt counts UTF-16 units and users count characters.
+* Every node knows its size in all three units, so a position is converted by walking
+* down the tree once and scanning a single leaf, O(log n) instead of decoding the text.
+* - unitsOf
+* - findUnit
+* - toOffset
+* - fromOffset
+* - getCharCount
+* - getUtf16Length
+* - charOfOffset
+* - offsetOfChar
+* - utf16OfOffset
+* - offsetOfUtf16
+* - charOfUtf16
+* - utf16OfChar
 */
 
 /**
- * Appends the given rope to the end of this rope.
+ * Retrieves the size of a subtree in the given unit.
  *
- * @param rope The rope to append to this rope.
+ * @param node The root of the subtree.
+ * @param unit The unit to measure in.
  *
- * @return void
+ * @return The number of bytes, code points or UTF-16 units in the subtree.
  *
  * @throws None
  */
-void Rope::append(const Rope& rope)
+Rope::Size Rope::unitsOf(const Node* node, Unit unit)
 {
-    Node* newRoot = merge(root, rope.root);
-    root = newRoot;
+    switch (unit) {
+        case Unit::Char:  return node->getChars();
+        case Unit::Utf16: return node->getUtf16();
+        case Unit::Line:  return node->getLines();
+        default:          return node->getWeight();
+    }
 }
 
 /**
- * Appends a new node containing the given string and length to the end of the rope.
+ * Finds the leaf holding a position given in a unit other than bytes. Counted subtrees are
+ * skipped by their counts, and subtrees that are not counted yet, in a lazily loaded rope,
+ * are searched leaf by leaf from the left, so only the text before the position is read.
+ * A subtree searched to its end is counted on the way.
  *
- * @param str The string to append.
- * @param len The length of the string.
+ * @param node The root of the subtree to search.
+ * @param index The position in the subtree, left relative to the leaf found, or reduced by
+ *              the size of the subtree if the position is past its end.
+ * @param offset Increased by the bytes before the leaf found, or by the whole subtree.
+ * @param unit The unit the position is given in.
  *
- * @return void
+ * @return The leaf, or nullptr if the position is past the end of the subtree.
  *
  * @throws None
  */
-void Rope::append(const char str[], uint32_t len)
+const Rope::Node* Rope::findUnit(const Node* node, Size& index, Size& offset, Unit unit)
 {
-    
-    vector<pair<char*, uint32_t>> chunks = splitTextIntoChunks(str, len);
-
-    for (auto& chunk : chunks) {
-        if (chunk.first == nullptr) {
-            continue;
+    if (node->getIsCounted() || node->getIsLeaf()) {
+        if (index >= unitsOf(counted(node), unit)) { // Counting a leaf reads it, as the caller would
+            index -= unitsOf(node, unit);
+            offset += node->getWeight();
+            return nullptr;
         }
 
-        Node* newNode = new Node(chunk.first, chunk.second);
-
-        if (root == nullptr) {
-            root = newNode;
-            delete[] chunk.first;
-            continue;
+        if (node->getIsLeaf()) {
+            return node;
         }
-        root = merge(root, newNode);
-        delete[] chunk.first;
-        
     }
-}
 
-/**
- * Prepends the given rope to the beginning of this rope.
- *
- * @param rope The rope to prepend to this rope.
- *
- * @return void
- *
- * @throws None
- */
-void Rope::prepend(const Rope& rope)
-{
-    if (root == nullptr) {
-        root = rope.root;
-        return;
+    const Node* leaf = findUnit(node->getLeft(), index, offset, unit);
+    if (leaf == nullptr) {
+        leaf = findUnit(node->getRight(), index, offset, unit);
+    }
+
+    if (leaf == nullptr && !node->getIsCounted()) {
+        const_cast<Node*>(node)->count(); // Both children were searched to their end
     }
 
-    root = merge(rope.root, root);
+    return leaf;
 }
 
 /**
- * Prepends a new node containing the given string and length to the beginning of the rope.
+ * Converts a position given in code points or UTF-16 units to a byte offset.
+ * A UTF-16 position between the two halves of a surrogate pair maps to the start of the character.
  *
- * @param str The string to prepend.
- * @param len The length of the string.
+ * @param index The position to convert.
+ * @param unit The unit the position is given in.
  *
- * @return void
+ * @return The byte offset of the position, or the length of the rope if it is past the end.
  *
  * @throws None
  */
-void Rope::prepend(const char str[], uint32_t len)
+Rope::Size Rope::toOffset(Size index, Unit unit) const
 {
-    vector<pair<char*, uint32_t>> chunks = splitTextIntoChunks(str, len);
+    if (root == nullptr || unit == Unit::Byte) {
+        return min(index, getLength());
+    }
 
-    for (auto& chunk : chunks) {
-        if (chunk.first == nullptr) {
-            continue;
-        }
+    Size offset = 0;
+    const Node* node = findUnit(root, index, offset, unit);
 
-        
+    if (node == nullptr) {
+        return getLength();
+    }
 
-        Node* newNode = new Node(chunk.first, chunk.second);
+    // Skip whole characters until the position falls inside the next one, continuation
+    // bytes of a character begun in an earlier leaf are skipped along the way
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(node->getData());
+    uint32_t i = 0;
 
-        if (root == nullptr) {
-            root = newNode;
-            delete[] chunk.first;
-            continue;
-        }
+    for (; i < node->getLength(); i++) {
+        if ((data[i] & 0xC0) == 0x80) { continue; }
 
-        root = merge(newNode, root);
-        delete[] chunk.first;
+        uint32_t size = (unit == Unit::Utf16 && data[i] >= 0xF0) ? 2 : 1;
+        if (index < size) { break; }
 
-        
+        index -= size;
     }
+
+    return offset + i;
 }
 
 /**
- * Inserts a new string at the specified position in the rope.
+ * Converts a byte offset to a position in code points or UTF-16 units.
+ * An offset inside a multi-byte character counts that character.
  *
- * @param pos The position at which the string should be inserted.
- * @param str The string to be inserted.
- * @param len The length of the string.
+ * @param pos The byte offset, offsets past the end are clamped to it.
+ * @param unit The unit to convert to.
+ *
+ * @return The position in the given unit.
  *
  * @throws None
  */
-void Rope::insert(uint32_t pos, const char str[], uint32_t len)
+Rope::Size Rope::fromOffset(Size pos, Unit unit) const
 {
+    if (root == nullptr || unit == Unit::Byte) {
+        return min(pos, getLength());
+    }
 
-    vector<pair<char*, uint32_t>> chunks = splitTextIntoChunks(str, len);
-
-    uint32_t currentPos = 0;
-
-    for (auto& chunk : chunks) {
-        if (chunk.first == nullptr) {
-            continue;
-        }
-        
-        uint32_t adjustedPos = pos + currentPos;
+    const Node* node = root;
+    Size index = 0;
 
-        
+    while (!node->getIsLeaf()) {
+        const Node* left = node->getLeft();
 
-        if (adjustedPos == 0) { // Prepend
-            prepend(chunk.first, chunk.second);
-        }
-        else if (adjustedPos >= root->getWeight()) { // Append
-            append(chunk.first, chunk.second);
-            
+        if (pos < left->getWeight()) {
+            node = left;
         }
         else {
-            
-            auto splitResult = split(root, adjustedPos);
-            
-
-            Node *newNode = new Node(chunk.first, chunk.second);
-            
-
-            Node *leftSubtree = merge(splitResult.first, newNode);
-            root = merge(leftSubtree , splitResult.second);
+            index += unitsOf(counted(left), unit);
+            pos -= left->getWeight();
+            node = node->getRight();
         }
+    }
 
-        currentPos += chunk.second;
-
-        
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(node->getData());
+    uint32_t end = uint32_t(min<Size>(pos, node->getLength()));
 
-        delete[] chunk.first;
+    for (uint32_t i = 0; i < end; i++) {
+        if ((data[i] & 0xC0) == 0x80) { continue; }
 
-        
+        index += (unit == Unit::Utf16 && data[i] >= 0xF0) ? 2 : 1;
     }
+
+    return index;
 }
 
 /**
- * Inserts a rope at the specified position in the rope.
- *
- * @param pos The position at which the rope should be inserted.
- * @param rope The rope to be inserted.
- *
- * @return None
+ * Retrieves the number of code points in the rope.
  *
- * @throws None
+ * @return The length of the text in characters.
  */
-void Rope::insert(uint32_t pos, const Rope& rope)
+Rope::Size Rope::getCharCount() const
 {
-    if (pos == 0) { // Prepend
-        prepend(rope);
-        return;
-    }
-
-    if (pos >= root->getWeight()) { // Append
-        append(rope);
-        return;
-    }
-
-    
-    auto splitResult = split(root, pos);
-    
-
-    Node* leftSubtree = merge(splitResult.first, rope.root);
-    root = merge(leftSubtree , splitResult.second);
+    return root ? counted(root)->getChars() : 0;
 }
 
 /**
- * Removes a character at the specified position from the rope.
- *
- * @param pos The position of the character to be removed.
+ * Retrieves the number of UTF-16 units in the rope, the length QTextDocument reports for the same text.
  *
- * @throws None
+ * @return The length of the text in UTF-16 units.
  */
-void Rope::remove(uint32_t pos)
+Rope::Size Rope::getUtf16Length() const
 {
-    auto splitResult = split(root, pos);
-    root = merge(splitResult.first, splitResult.second);
+    return root ? counted(root)->getUtf16() : 0;
 }
 
 /**
- * Removes a range of characters from the rope starting from 'start' position to 'end' position.
- *
- * @param start The starting position of the range to be removed.
- * @param end The ending position of the range to be removed.
+ * Converts a byte offset to a code point index.
  *
- * @return None
+ * @param pos The byte offset.
  *
- * @throws None
+ * @return The number of characters before the offset.
  */
-void Rope::remove(uint32_t start, uint32_t length)
+Rope::Size Rope::charOfOffset(Size pos) const
 {
-    auto splitStart = split(root, start);
-    
-    if (splitStart.second == nullptr) {
-        root = splitStart.first;
-        
-        return;
-    }
-
-
-    auto splitEnd = split(splitStart.second, length);
-    
-
-    if (splitEnd.second == nullptr) {
-        root = splitStart.first;
-        
-        
-        return;
-    }
-    if (splitStart.first == nullptr) {
-        root = splitEnd.second;
-        
-        
-        return;
-    }
-    
-    root = merge(splitStart.first, splitEnd.second);
-    
+    return fromOffset(pos, Unit::Char);
 }
 
-
 /**
- * Cuts a range of characters from the rope starting from 'start' position to 'end' position.
+ * Converts a code point index to a byte offset.
  *
- * @param start The starting position of the range to be cut.
- * @param end The ending position of the range to be cut.
- *
- * @return A new Rope object containing the cut range of characters.
+ * @param index The character index.
  *
- * @throws None
+ * @return The byte offset of the character.
  */
-Rope* Rope::cut(uint32_t start, uint32_t end)
+Rope::Size Rope::offsetOfChar(Size index) const
 {
-    auto splitResult = split(root, start);
-    
-    //auto splitEnd = split(splitResult.second, end - start);
-    auto splitEnd = split(splitResult.second, end);
-    
-    
-    Rope* rope = new Rope(splitEnd.first);
-
-    
-    rope->printTree();
-
-    return rope;
+    return toOffset(index, Unit::Char);
 }
 
-
 /**
- * Inserts the contents of the given rope `r` at the specified position `pos` in the current rope.
+ * Converts a byte offset to a UTF-16 position, as used by QTextCursor::position().
  *
- * @param pos The position at which the contents of `r` should be inserted.
- * @param r The rope whose contents should be inserted.
+ * @param pos The byte offset.
  *
- * @throws None
+ * @return The number of UTF-16 units before the offset.
  */
-void Rope::paste(uint32_t pos, const Rope* r)
+Rope::Size Rope::utf16OfOffset(Size pos) const
 {
-    insert(pos, *r);
+    return fromOffset(pos, Unit::Utf16);
 }
 
-
-
-void Rope::load(const char filename[])
+/**
+ * Converts a UTF-16 position, as used by QTextCursor::position(), to a byte offset.
+ *
+ * @param index The UTF-16 position.
+ *
+ * @return The byte offset of the position.
+ */
+Rope::Size Rope::offsetOfUtf16(Size index) const
 {
-    ifstream file(filename);
-
-    if (!file.is_open()) {
-        cout << "Error opening file" << endl;
-        return;
-    }
-
-    string line;
-    while (getline(file, line))
-    {
-        append(line.c_str(), line.length());
-    }
-
-    file.close();
-    return;
+    return toOffset(index, Unit::Utf16);
 }
 
-void Rope::save(const char filename[])
+/**
+ * Converts a UTF-16 position to a code point index.
+ *
+ * @param index The UTF-16 position.
+ *
+ * @return The number of characters before the position.
+ */
+Rope::Size Rope::charOfUtf16(Size index) const
 {
-    ofstream file (filename);
-    string str = toString();
-
-    if (!file.is_open()) {
-        std::cerr << "Error opening file" << std::endl;
-    }
-    else {
-        file << str;
-        file.close();
-        cout << "Data has been written to : " << filename << endl;
-    }
-
+    return fromOffset(toOffset(index, Unit::Utf16), Unit::Char);
 }
 
-uint32_t Rope::getLength() const
+/**
+ * Converts a code point index to a UTF-16 position.
+ *
+ * @param index The character index.
+ *
+ * @return The number of UTF-16 units before the character.
+ */
+Rope::Size Rope::utf16OfChar(Size index) const
 {
-    return root->getWeight();
+    return fromOffset(toOffset(index, Unit::Char), Unit::Utf16);
 }
 
 /*
@@ -634,9 +1954,10 @@ uint32_t Rope::getLength() const
 */
 
 /**
- * Sets the chunk size for the Rope object.
+ * Sets the chunk size for the Rope object and derives the leaf size bounds from it.
+ * Leaves aim for chunkSize bytes and are kept between half and twice that size.
  *
- * @param chunkSize The size of each chunk in the rope.
+ * @param chunkSize The target size of each leaf in the rope.
  *
  * @return void
  *
@@ -645,88 +1966,255 @@ uint32_t Rope::getLength() const
 void Rope::setChunkSize(uint32_t chunkSize)
 {
     this->chunkSize = chunkSize;
+    this->minLeafSize = chunkSize / 2;
+    this->maxLeafSize = chunkSize * 2;
 }
 
 /**
  * Adjusts the chunk size based on the file size.
+ * Below 64 bytes the node header outweighs the text it points to, so no tier goes lower.
  *
  * @param fileSize The size of the file in bytes.
  *
  * @throws None
  */
-void Rope::adjustParameters(uint32_t fileSize)
+void Rope::adjustParameters(Size fileSize)
 {   
     if (fileSize <= 100) { // Tiny file or just maunally making the rope
-        chunkSize = 10;
+        setChunkSize(64);
     }
     else if (fileSize <= 1000000) { // Small file
-        chunkSize = 100;
+        setChunkSize(512);
     } else if (fileSize <= 10000000) { // Medium file
-        chunkSize = 1000;
+        setChunkSize(1024);
     } else if (fileSize <= 100000000) { // Large file
-        chunkSize = 10000;
+        setChunkSize(2048);
     } else { // Huge file
-        chunkSize = 100000;
+        setChunkSize(4096);
     }
 }
 
-vector<pair<char*, uint32_t>> Rope::splitTextIntoChunks(const char* text, uint32_t length)
+/**
+ * Splits text into leaf-sized chunks following the leaf policy.
+ * Every chunk is at most maxLeafSize bytes and, unless the whole text is shorter, at least
+ * minLeafSize bytes. Chunks prefer to end right after the newline closest to chunkSize,
+ * and otherwise never end in the middle of a UTF-8 sequence.
+ *
+ * @param text The text to split.
+ * @param length The length of the text.
+ *
+ * @return The lengths of the chunks, in text order. The text itself is not copied.
+ *
+ * @throws None
+ */
+vector<uint32_t> Rope::splitTextIntoChunks(const char* text, Size length)
 {
-    vector<pair<char*, uint32_t>> chunks;
+    vector<uint32_t> chunks;
+    chunks.reserve(length / chunkSize + 1);
 
-    uint32_t startIndex = 0;
+    Size startIndex = 0;
 
-    /*
     while (startIndex < length) {
-        uint32_t endIndex = min(startIndex + chunkSize, length);
-
-        size_t newlinePos = std::string(text + startIndex, endIndex - startIndex).find('\n');
-        if (newlinePos != std::string::npos) {
-            endIndex = startIndex + newlinePos + 1; // Include the newline character
+        Size remaining = length - startIndex;
+        uint32_t chunkLength = uint32_t(remaining); // Only kept whole when it fits in a leaf
+
+        if (remaining > maxLeafSize) {
+            // Never leave a tail shorter than minLeafSize behind
+            uint32_t lowest = max(minLeafSize, 1u);
+            uint32_t highest = uint32_t(min<Size>(maxLeafSize, remaining - minLeafSize));
+            chunkLength = chunkSize;
+
+            const char* start = text + startIndex;
+            uint32_t cut = 0;
+
+            for (uint32_t i = chunkSize; i >= lowest; i--) { // Last newline before the target
+                if (start[i - 1] == '\n') {
+                    cut = i;
+                    break;
+                }
+            }
+
+            if (cut == 0 && highest > chunkSize) { // First newline after the target
+                const char* newline = static_cast<const char*>(memchr(start + chunkSize, '\n', highest - chunkSize));
+                if (newline != nullptr) {
+                    cut = uint32_t(newline - start) + 1;
+                }
+            }
+
+            if (cut != 0) {
+                chunkLength = cut;
+            }
+            else {
+                // Do not cut a UTF-8 sequence in two, the leaves stay valid text on their own
+                for (int back = 0; back < 3 && (start[chunkLength] & 0xC0) == 0x80; back++) {
+                    chunkLength--;
+                }
+            }
         }
 
-        char* chunk = new char[endIndex - startIndex + 1];
-        memcpy(chunk, text + startIndex, endIndex - startIndex);
-        chunk[endIndex - startIndex] = '\0';
+        chunks.push_back(chunkLength);
+        startIndex += chunkLength;
+    }
+
+    return chunks;
+}
+
+/*
+* ROPE STATISTICS FUNCTIONS
+* =========================
+* These functions walk the whole tree, they are meant for reports and tests.
+* - getLeafCount
+* - getNodeSize
+* - memoryOverhead
+* - checkInvariants
+*/
+
+/**
+ * Counts the leaves of the rope.
+ *
+ * @return The number of leaf nodes.
+ */
+uint32_t Rope::getLeafCount() const
+{
+    uint32_t leaves = 0;
 
-        cout << "Chunk : " << chunk << " " << endIndex - startIndex << endl;
+    stack<const Node*> nodeStack;
+    nodeStack.push(root);
 
-        chunks.push_back(make_pair(chunk, endIndex - startIndex));
+    while (!nodeStack.empty()) {
+        const Node* currNode = nodeStack.top();
+        nodeStack.pop();
 
-        startIndex = endIndex;
+        if (currNode == nullptr) { continue; }
 
-        if (startIndex >= length) {
-            break;
+        if (currNode->getIsLeaf()) {
+            leaves++;
+            continue;
         }
+
+        nodeStack.push(currNode->getLeft());
+        nodeStack.push(currNode->getRight());
     }
-    */
 
-    while (startIndex < length) {
-        uint32_t endIndex;
-        char* chunk;
-        size_t newlinePos = std::string(text + startIndex, length - startIndex).find('\n');
-        if (newlinePos != std::string::npos) {
-            endIndex = startIndex + newlinePos + 1; // Include the newline character
-            chunk = new char[endIndex - startIndex + 1];
-            memcpy(chunk, text + startIndex, endIndex - startIndex);
-            chunk[endIndex - startIndex] = '\0';
-        }
-        else {
-            endIndex = length;
-            chunk = new char[endIndex - startIndex + 1];
-            memcpy(chunk, text + startIndex, endIndex - startIndex);
-            chunk[endIndex - startIndex] = '\0';
+    return leaves;
+}
+
+/**
+ * Retrieves the number of bytes a node takes in the arena, leaves and internal nodes alike.
+ *
+ * @return The size of a node.
+ */
+size_t Rope::getNodeSize()
+{
+    return sizeof(Node);
+}
+
+/**
+ * Computes how many bytes of bookkeeping the rope spends per byte of text.
+ * Node headers, buffer headers and every buffer byte no leaf slices any more count as overhead.
+ * Shared nodes and buffers are only counted once.
+ *
+ * @return The overhead in bytes per byte of text, or 0 for an empty rope.
+ */
+double Rope::memoryOverhead() const
+{
+    uint64_t textBytes = 0;
+    uint64_t totalBytes = 0;
+    unordered_set<const Buffer*> buffers;
+    unordered_set<const Node*> nodes;
+
+    stack<const Node*> nodeStack;
+    nodeStack.push(root);
+
+    while (!nodeStack.empty()) {
+        const Node* currNode = nodeStack.top();
+        nodeStack.pop();
+
+        if (currNode == nullptr || !nodes.insert(currNode).second) { continue; }
+
+        totalBytes += sizeof(Node);
+
+        if (currNode->getIsLeaf()) {
+            textBytes += currNode->getLength();
+
+            const Buffer* buffer = currNode->getBuffer();
+            if (buffer != nullptr && buffers.insert(buffer).second) {
+                totalBytes += Arena::bufferCapacity(sizeof(Buffer) + buffer->size);
+            }
+            else if (currNode->getIsMapped()) {
+                totalBytes += currNode->getLength(); // Lives in the file mapping, not in the arena
+            }
+            continue;
         }
 
-        chunks.push_back(make_pair(chunk, endIndex - startIndex));
-        startIndex = endIndex;
+        nodeStack.push(currNode->getLeft());
+        nodeStack.push(currNode->getRight());
+    }
+
+    return textBytes ? double(totalBytes - textBytes) / double(textBytes) : 0.0;
+}
+
+/**
+ * Checks the structure of the tree: every node is AVL balanced and its stored height, weight
+ * and counts match its children, or its text for a leaf.
+ *
+ * @return true if every node is consistent, false otherwise.
+ */
+bool Rope::checkInvariants() const
+{
+    stack<const Node*> nodeStack;
+    nodeStack.push(root);
+
+    while (!nodeStack.empty()) {
+        const Node* currNode = nodeStack.top();
+        nodeStack.pop();
+
+        if (currNode == nullptr) { continue; }
+
+        if (currNode->getIsLeaf()) {
+            const char* data = currNode->getData();
+            uint32_t length = currNode->getLength();
+
+            Size lines = 0, chars = 0, utf16 = 0;
+            for (uint32_t i = 0; i < length; i++) {
+                unsigned char c = data[i];
+                lines += c == '\n';
+                chars += (c & 0xC0) != 0x80;
+                utf16 += ((c & 0xC0) != 0x80) + (c >= 0xF0);
+            }
+
+            if (currNode->getHeight() != 0 || currNode->getWeight() != length || (length == 0 && currNode != root)) return false;
+            if (!currNode->getIsCounted()) {
+                if (currNode->getPager() == nullptr) return false; // Only a Paged leaf may be left unread
+                continue;
+            }
+            if (currNode->getLines() != lines || currNode->getChars() != chars || currNode->getUtf16() != utf16) return false;
+            continue;
+        }
 
-        if (startIndex >= length) {
-            break;
+        const Node* left = currNode->getLeft();
+        const Node* right = currNode->getRight();
+        if (left == nullptr || right == nullptr) return false;
+
+        if (currNode->getHeight() != max(left->getHeight(), right->getHeight()) + 1) return false;
+        if (left->getHeight() > right->getHeight() + 1 || right->getHeight() > left->getHeight() + 1) return false;
+        if (currNode->getWeight() != left->getWeight() + right->getWeight()) return false;
+        // A node shared with another rope can stay uncounted after that rope counted its children
+        if (currNode->getIsCounted() && !(left->getIsCounted() && right->getIsCounted())) return false;
+        if (!currNode->getIsCounted()) {
+            nodeStack.push(left);
+            nodeStack.push(right);
+            continue;
         }
+        if (currNode->getLines() != left->getLines() + right->getLines()) return false;
+        if (currNode->getChars() != left->getChars() + right->getChars()) return false;
+        if (currNode->getUtf16() != left->getUtf16() + right->getUtf16()) return false;
 
+        nodeStack.push(left);
+        nodeStack.push(right);
     }
-    return chunks;
+
+    return true;
 }
 
 /*
@@ -745,7 +2233,14 @@ vector<pair<char*, uint32_t>> Rope::splitTextIntoChunks(const char* text, uint32
  */
 string Rope::toString() const
 {
-    return root->transversePreOrder();
+    string str;
+    str.reserve(getLength());
+
+    for (ChunkIterator it = chunksBegin(); it != chunksEnd(); ++it) {
+        str.append(*it);
+    }
+
+    return str;
 }
 
 /**
@@ -759,5 +2254,7 @@ string Rope::toString() const
  */
 void Rope::printTree()
 {
-    root->printTree();
+    if (root != nullptr) {
+        root->printTree();
+    }
 }
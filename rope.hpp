@@ -2,36 +2,111 @@
 #define ROPE_HPP
 
 #pragma once
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <regex>
 #include <stack>
+#include <stdexcept>
 #include <fstream>
+#include <filesystem>
+#include <memory>
+#include <atomic>
+#include <new>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_set>
 
 using namespace std;
 
 class Rope {
+public:
+    /*
+     * Type of every length and position in a rope. Leaves stay small, so only the
+     * subtree totals need the wider type. Define ROPE_64BIT for documents over 4GB,
+     * at the cost of 16 more bytes per node.
+     */
+#ifdef ROPE_64BIT
+    typedef uint64_t Size;
+#else
+    typedef uint32_t Size;
+#endif
+
 private:
-    class Node {
-    private:
+    class Arena;
+    class Pager;
+
+    /*
+     * Reference-counted text buffer shared by leaf slices.
+     * The text follows the header in the same arena allocation. A buffer is returned
+     * to the arena when the last leaf slicing it is destroyed.
+     */
+    struct Buffer {
+        uint32_t refs;  // Number of leaves slicing this buffer
+        uint32_t size;  // Number of text bytes allocated after the header, including slack
+
+        char* text() { return reinterpret_cast<char*>(this + 1); }
+    };
 
-        char *data;
-        uint32_t length;
+    class Node {
+    public:
+        // Where the text of a leaf lives
+        enum class Storage : uint8_t {
+            Shared, // A slice of an arena buffer
+            Inline, // In the node itself, for text of up to INLINE_SIZE bytes
+            Mapped, // A read-only view into a file mapped by the arena
+            Paged   // A view into a lazily loaded file, its counts are only known once it has been read
+        };
 
-        Node* left;
-        Node* right;
-        
-        uint32_t weight;// Weight of the node (sum of left + right children) or lenght of the data if the node is a leaf
-        uint32_t height;// Height of the node
-        bool isLeaf;// Flag to differentiate between leaf and internal nodes
+    private:
 
-        void setWeight(uint32_t weight);    
-        void updateWeight(Node* node);
+        // A leaf slices a shared buffer, holds short text inline or views a mapped file, and an
+        // internal node links two children, so the layouts overlay each other. A leaf's length is its weight.
+        struct Slice {
+            Buffer* buffer; // Shared text buffer, the leaf is the slice [offset, offset + weight) of it
+            uint32_t offset;
+        };
+
+        struct View {
+            const char* text;
+            Pager* pager;   // Told about every read of a Paged leaf, nullptr for a Mapped one
+        };
+
+        struct Children {
+            Node* left;
+            Node* right;
+        };
+
+        union {
+            Slice slice;                        // When the storage is Shared
+            char text[sizeof(Children)];        // When the storage is Inline
+            View view;                          // When the storage is Mapped or Paged
+            Children children;                  // When not isLeaf
+        };
+
+        Size weight;// Weight of the node (sum of left + right children) or lenght of the data if the node is a leaf
+        Size lines;// Number of newlines in the subtree
+        Size chars;// Number of UTF-8 code points in the subtree
+        Size utf16;// Number of UTF-16 code units in the subtree, as counted by Qt
+        uint32_t refs;// Number of parents and ropes sharing this node, a shared node is never modified
+        uint8_t height;// Height of the node, an AVL tree of 2^64 leaves is under 100 high
+        bool isLeaf;// Tag telling which layout of the union is in use
+        Storage storage;// Where the text of a leaf lives, Shared for internal nodes
+        bool counted;// Whether lines, chars and utf16 hold the counts of the whole subtree, false until every Paged leaf in it has been read
+
+        void setWeight(Size weight);    
 
         void setHeight(uint32_t height);
-        void updateHeight(Node* node);
+
+        void countText();
+        void addCounts(const char* str, uint32_t len, bool remove);
 
         int balanceFactor(Node* node);
         
@@ -41,32 +116,32 @@ private:
 
 
     public:
-        Node(const char str[], uint32_t len);
+        static constexpr uint32_t INLINE_SIZE = sizeof(Children); // Longest text a leaf holds inline
+
+        Node(Buffer* buffer, uint32_t offset, uint32_t len);
+        Node(const char* str, uint32_t len, Storage storage);
+        Node(const char* str, uint32_t len, Pager* pager);
         Node(Node* left, Node* right);
-        ~Node();
-
-        Node(const Node& other) {
-            data = new char[other.length];
-            std::copy(other.data, other.data + other.length, data);
-            length = other.length;
-            weight = other.weight;
-            height = other.height;
-            isLeaf = other.isLeaf;
-            if (other.isLeaf) {
-                left = nullptr;
-                right = nullptr;
-            } else {
-                left = new Node(*other.left);
-                right = new Node(*other.right);
-            }
-        }
 
-        uint32_t getWeight() const;
+        Node(const Node& other) = delete; // Nodes live in an Arena, use Rope::copyNode
+
+        uint32_t getRefs() const;
+        void retain();
+        uint32_t release();
+
+        Size getWeight() const;
         void updateWeight();
 
         uint32_t getHeight() const;
         void updateHeight();
 
+        Size getLines() const;
+        Size getChars() const;
+        Size getUtf16() const;
+
+        bool getIsCounted() const;
+        void count();
+
         uint32_t getLength() const;
         void setLength(uint32_t len);
 
@@ -79,9 +154,15 @@ private:
         void setRight(Node* node);
 
         char* getData() const;
-        void setData(const char* str, uint32_t len);
+        void setData(Arena& arena, const char* str, uint32_t len);
+        void editText(Arena& arena, uint32_t pos, uint32_t removed, const char* str, uint32_t len, uint32_t slack);
+
+        Buffer* getBuffer() const;
+        uint32_t getOffset() const;
 
         bool getIsLeaf() const;
+        bool getIsMapped() const;
+        Pager* getPager() const;
 
         string toString() const;
 
@@ -90,38 +171,384 @@ private:
         void printTree();
     };
 
+    /*
+     * Keeps the pages of a lazily loaded file within a memory budget.
+     * The file is mapped, so the system faults a page in when a Paged leaf first reads it.
+     * Paged leaves report every read, and once more than the budget has been read the least
+     * recently read pages are handed back to the system. They are clean copies of the file,
+     * so dropping them costs no write and the next read faults them in again.
+     */
+    class Pager {
+    public:
+        static constexpr uint32_t PAGE_SIZE = 1 << 16;              // 64KB, the length of a placeholder leaf
+        static constexpr size_t DEFAULT_BUDGET = size_t(256) << 20; // 256MB
+
+    private:
+        static constexpr uint32_t NONE = numeric_limits<uint32_t>::max();
+
+        struct Page {
+            uint32_t newer; // Neighbours in the list of resident pages, by time of last read
+            uint32_t older;
+            bool resident;
+        };
+
+        mutable mutex lock;
+        const char* base;
+        uint64_t length;
+        vector<Page> pages;
+        atomic<uint32_t> newest; // Page of the last read, another read in it skips the lock
+        uint32_t oldest;
+        size_t budget;
+        size_t residentBytes;
+
+        uint32_t pageLength(uint32_t page) const;
+        void unlink(uint32_t page);
+        void evict(uint32_t page);
+
+    public:
+        Pager(const char* base, uint64_t length, size_t budget);
+
+        Pager(const Pager&) = delete;
+        Pager& operator =(const Pager&) = delete;
+
+        const char* getBase() const { return base; }
+
+        void touch(const char* text);
+        void setBudget(size_t budget);
+        size_t getResidentBytes() const;
+    };
+
+    /*
+     * Memory arena shared by a rope and its copies.
+     * Nodes are carved out of fixed-size slabs and recycled through a free list,
+     * leaf text comes from a pool of size classes. Destroying the arena releases
+     * every slab at once, so the tree is never walked to free it.
+     */
+    class Arena {
+    private:
+        struct FreeSlot {
+            FreeSlot* next;
+        };
+
+        // Slabs start small so tiny ropes stay cheap, and double up to the max size
+        static constexpr uint32_t MIN_NODES_PER_SLAB = 32;
+        static constexpr uint32_t MAX_NODES_PER_SLAB = 4096;
+        static constexpr uint32_t MIN_BUFFER_SLAB_SIZE = 1 << 12;  // 4KB
+        static constexpr uint32_t MAX_BUFFER_SLAB_SIZE = 1 << 20;  // 1MB
+        static constexpr uint32_t MAX_BUFFER_SIZE = 1 << 17;       // 128KB
+        static constexpr uint32_t NUM_BUFFER_CLASSES = 52;          // 8, 16, 24, 32, then 4 classes per power of two
+
+        vector<void*> nodeSlabs;
+        FreeSlot* freeNodes;
+        uint32_t slabNodesUsed;
+        uint32_t slabNodesCapacity;
+
+        vector<char*> bufferSlabs;
+        uint32_t slabBytesUsed;
+        uint32_t slabBytesCapacity;
+        FreeSlot* freeBuffers[NUM_BUFFER_CLASSES];
+
+        unordered_set<char*> largeBuffers; // Buffers above MAX_BUFFER_SIZE, allocated individually
+
+        struct Mapping {
+            void* address;
+            size_t length;
+            string filename;
+        };
+
+        vector<Mapping> mappings; // Files mapped for leaves that view them, unmapped with the arena
+
+        vector<unique_ptr<Pager>> pagers; // One per lazily loaded file
+        size_t pageBudget;                // Given to every pager of the arena
+
+        static uint32_t bufferClass(uint32_t size);
+        static uint32_t classSize(uint32_t sizeClass);
+
+        vector<Node*> liveNodes() const;
+        static void unmap(const Mapping& mapping);
+
+    public:
+        Arena();
+        ~Arena();
+
+        Arena(const Arena&) = delete;
+        Arena& operator =(const Arena&) = delete;
+
+        void* allocateNode();
+        void freeNode(void* slot);
+
+        char* allocateBuffer(uint32_t size);
+        void freeBuffer(char* buffer, uint32_t size);
+
+        static uint32_t bufferCapacity(uint32_t size);
+
+        Buffer* createBuffer(uint32_t size);
+        void retain(Buffer* buffer);
+        void release(Buffer* buffer);
+
+        const char* mapFile(const char filename[], uint64_t& length);
+        bool hasMappings() const;
+        bool mapsFile(const char filename[]) const;
+        void unmapFile(const char filename[]);
+
+        Pager* createPager(const char* text, uint64_t length);
+        void setPageBudget(size_t budget);
+        size_t getResidentBytes() const;
+
+        void clear();
+    };
+
+    /*
+     * Worker thread that destroys the arenas of ropes handed to Rope::reclaim().
+     * A rope that owns its arena alone owns every node and buffer in it, so the arena can
+     * be freed on another thread without touching anything a live rope can see.
+     * The worker starts with the first reclaimed rope and drains the queue at exit.
+     */
+    class Reclaimer {
+    private:
+        mutex lock;
+        condition_variable ready; // Signalled when an arena is queued or the worker must stop
+        condition_variable idle;  // Signalled when the queue has been drained
+        vector<shared_ptr<Arena>> queue;
+        bool busy;
+        bool stopping;
+        thread worker;
+
+        Reclaimer();
+        void run();
+
+    public:
+        ~Reclaimer();
+
+        Reclaimer(const Reclaimer&) = delete;
+        Reclaimer& operator =(const Reclaimer&) = delete;
+
+        static Reclaimer& instance();
+
+        void push(shared_ptr<Arena> arena);
+        void wait();
+    };
+
+    shared_ptr<Arena> arena = make_shared<Arena>(); // Shared by every rope whose tree shares nodes with this one
     Node* root;
 
-    std::pair<Node*, Node*> split(Node* node, uint32_t pos) ;
+    Node* createLeaf(const char str[], uint32_t len);
+    Node* createView(const char str[], uint32_t len, Pager* pager = nullptr);
+    Node* createSlice(const Node* leaf, uint32_t start, uint32_t len);
+    Node* createNode(Node* left, Node* right);
+    void destroyNode(Node* node);
+
+    static Node* retain(Node* node);
+    void releaseTree(Node* node);
+    Node* makeUnique(Node* node);
+    std::pair<Node*, Node*> takeChildren(Node* node);
+    Node* shareTree(const Rope& rope);
+
+    Node* buildTree(const char str[], Size len, bool view = false);
+    Node* buildBalanced(const vector<Node*>& leaves, size_t begin, size_t end);
+    Node* buildPages(const char str[], Size len, Pager* pager);
+    Node* readTree(istream& in, uint64_t length);
+
+    std::pair<Node*, Node*> split(Node* node, Size pos) ;
     Node* merge(Node* left, Node* right);
+    Node* concat(Node* left, Node* right);
+
+    // Coordinate systems a position in the text can be given in, Line counts newlines
+    enum class Unit { Byte, Char, Utf16, Line };
+
+    static const Node* counted(const Node* node);
+    static Size unitsOf(const Node* node, Unit unit);
+    static const Node* findUnit(const Node* node, Size& index, Size& offset, Unit unit);
+    Size toOffset(Size index, Unit unit) const;
+    Size fromOffset(Size pos, Unit unit) const;
+
+    static Node* leftmostLeaf(Node* node);
+    static Node* rightmostLeaf(Node* node);
 
     Node* rebalance(Node* node);
     Node* rotateLeft(Node* node);
     Node* rotateRight(Node* node);
 
-    uint32_t chunkSize = 100; // Adjust chunk size based on file size
+    // Leaf sizing policy, leaves aim for chunkSize and stay within [minLeafSize, maxLeafSize]
+    uint32_t chunkSize = 512; // Adjust chunk size based on file size
+    uint32_t minLeafSize = 256;
+    uint32_t maxLeafSize = 1024;
+
+    static constexpr uint32_t LOAD_BLOCK_SIZE = 1 << 20; // Bytes read at a time when a file is copied in
 
     void setChunkSize(uint32_t size);
 
     
 
-    vector<pair<char*, uint32_t>> splitTextIntoChunks(const char* text, uint32_t len);
+    vector<uint32_t> splitTextIntoChunks(const char* text, Size len);
+
+public:
+    static constexpr Size npos = numeric_limits<Size>::max(); // Returned by find() when there is no match
+
+    // How a file is brought in: Read copies it into the rope, Map views a read-only mapping of it,
+    // Lazy maps it too but only reads a page when the rope needs it, for files larger than memory
+    enum class LoadMode { Read, Map, Lazy };
+
+    /*
+     * Bidirectional iterator over the leaves of a rope, each seen as one contiguous chunk of text.
+     * It keeps the path from the root to its leaf, so stepping to a neighbouring leaf only
+     * climbs to their common ancestor: O(1) amortized over a walk, O(log n) to seek.
+     * Like the iterators of the standard containers, it is invalidated by edits to the rope,
+     * iterate over a copy of the rope (O(1)) to keep reading while editing.
+     */
+    class ChunkIterator {
+    private:
+        struct Step {
+            const Node* node;
+            bool right; // Whether the path continues into the right child
+        };
+
+        const Node* root;
+        vector<Step> path; // Ancestors of the current leaf
+        const Node* leaf;  // nullptr past the last chunk
+        Size start;        // Position of the first byte of the chunk in the rope
+
+        void descend(const Node* node, bool last);
+
+    public:
+        ChunkIterator(const Node* root, Size pos);
+
+        void seek(const Node* root, Size pos);
+
+        string_view operator*() const;
+        Size getOffset() const;
+
+        ChunkIterator& operator++();
+        ChunkIterator& operator--();
+
+        bool operator==(const ChunkIterator& other) const { return start == other.start && (leaf == nullptr) == (other.leaf == nullptr); }
+        bool operator!=(const ChunkIterator& other) const { return !(*this == other); }
+    };
+
+    /*
+     * Bidirectional iterator over the bytes of a rope, usable with the standard algorithms.
+     * Steps within the current chunk are a pointer increment.
+     */
+    class ByteIterator {
+    private:
+        ChunkIterator chunk;
+        const char* data;
+        uint32_t index;
+        uint32_t length;
+
+        void loadChunk();
+
+    public:
+        typedef bidirectional_iterator_tag iterator_category;
+        typedef char value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const char* pointer;
+        typedef const char& reference;
+
+        ByteIterator(const ChunkIterator& chunk, Size pos);
+
+        reference operator*() const { return data[index]; }
+        Size getPosition() const { return chunk.getOffset() + index; }
+        bool atEnd() const { return data == nullptr; }
+
+        ByteIterator& operator++();
+        ByteIterator& operator--();
+        ByteIterator operator++(int) { ByteIterator copy = *this; ++*this; return copy; }
+        ByteIterator operator--(int) { ByteIterator copy = *this; --*this; return copy; }
+
+        bool operator==(const ByteIterator& other) const { return getPosition() == other.getPosition(); }
+        bool operator!=(const ByteIterator& other) const { return !(*this == other); }
+    };
+
+    /*
+     * Bidirectional iterator over the code points of a UTF-8 rope.
+     * Malformed sequences decode to their lead byte.
+     */
+    class CharIterator {
+    private:
+        ByteIterator byte;
+
+    public:
+        typedef bidirectional_iterator_tag iterator_category;
+        typedef char32_t value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const char32_t* pointer;
+        typedef char32_t reference;
+
+        explicit CharIterator(const ByteIterator& byte) : byte(byte) {}
+
+        char32_t operator*() const;
+        Size getPosition() const { return byte.getPosition(); }
+
+        CharIterator& operator++();
+        CharIterator& operator--();
+        CharIterator operator++(int) { CharIterator copy = *this; ++*this; return copy; }
+        CharIterator operator--(int) { CharIterator copy = *this; --*this; return copy; }
+
+        bool operator==(const CharIterator& other) const { return byte == other.byte; }
+        bool operator!=(const CharIterator& other) const { return !(*this == other); }
+    };
+
+private:
+    /*
+     * Finger on the leaf of the last edit, with the path from the root to it.
+     * Only set while every node on the path belongs to this rope alone, so an edit that
+     * stays inside the leaf can edit it and fix the weights along the path in
+     * place instead of splitting and re-merging the tree from the root.
+     */
+    struct Finger {
+        vector<Node*> path; // Ancestors of the leaf, from the root down
+        Node* leaf = nullptr;
+        Size start = 0;     // Position of the first byte of the leaf in the rope
+    };
+
+    Finger finger;
+
+    // Leaf of the last indexed read, reads in it or in a neighbouring leaf skip the descent from the root
+    mutable ChunkIterator lastLeaf{nullptr, 0};
+
+    void resetCursors() { lastLeaf.seek(nullptr, 0); finger.leaf = nullptr; }
+
+    bool seekFinger(Size pos);
+    bool editLeaf(Size pos, Size removed, const char str[], Size len);
+
+public:
+    /*
+     * One change of a batch given to applyEdits(): the `removed` bytes at `pos` are replaced
+     * with `text`. Positions refer to the text before any edit of the batch is applied.
+     */
+    struct Edit {
+        Size pos;
+        Size removed;
+        string_view text;
+    };
+
+private:
+    Node* editTree(Node* node, Size offset, const vector<Edit>& edits);
 
 public:
     Rope();
-    Rope(const char str[], uint32_t len);
+    Rope(const char str[], Size len);
     Rope(Node* node);
     Rope(Node* left, Node* right);
-    Rope(const char filename[]);
+    Rope(const char filename[], LoadMode mode = LoadMode::Read);
     ~Rope();
 
-    Rope(const Rope& orig) {
-        root = copyNode(orig.root);
+    static void reclaim(Rope* rope);
+    static void waitForReclaim();
+
+    Rope(const Rope& orig) : arena(orig.arena) {
+        setChunkSize(orig.chunkSize);
+        root = retain(orig.root); // O(1), both ropes share the tree until one of them edits it
     }
 
     Rope& operator =(const Rope& orig) {
         if (this != &orig) {
-            root = copyNode(orig.root);
+            releaseTree(root);
+            resetCursors();
+            arena = orig.arena;
+            setChunkSize(orig.chunkSize);
+            root = retain(orig.root);
         }
         return *this;
     }
@@ -130,45 +557,89 @@ public:
         if (node == nullptr) {
             return nullptr;
         }
-        Node* newNode = new Node(node->getData(), node->getLength());
-        newNode->updateHeight();
-        newNode->updateWeight();
-        newNode->setLeft(copyNode(node->getLeft()));
-        newNode->setRight(copyNode(node->getRight()));
-        return newNode;
+        if (node->getIsLeaf()) {
+            return createLeaf(node->getData(), node->getLength());
+        }
+        return createNode(copyNode(node->getLeft()), copyNode(node->getRight()));
     }
 
-    void adjustParameters(uint32_t fileSize);
+    void adjustParameters(Size fileSize);
 
     void append(const Rope& rope);
-    void append(const char s[], uint32_t len);
+    void append(const char s[], Size len);
 
     void prepend(const Rope& rope);
-    void prepend(const char s[], uint32_t len);
+    void prepend(const char s[], Size len);
 
-    void insert(uint32_t pos, const Rope& rope);
-	void insert(uint32_t pos,const char s[], uint32_t len);
+    void insert(Size pos, const Rope& rope);
+	void insert(Size pos,const char s[], Size len);
 
-	void remove(uint32_t pos);
-	void remove(uint32_t start, uint32_t length);
+	void remove(Size pos);
+	void remove(Size start, Size length);
 
-	Rope* cut(uint32_t minline, uint32_t mincol, uint32_t maxline, uint32_t maxcol);
-    Rope* cut(uint32_t start, uint32_t end);
+    void applyEdits(const vector<Edit>& edits);
 
-	void paste(uint32_t start, uint32_t end, const Rope* r);
-    void paste(uint32_t start, const Rope* r);
+	Rope* cut(Size minline, Size mincol, Size maxline, Size maxcol);
+    Rope* cut(Size start, Size length);
+
+    Rope substr(Size pos, Size len) const;
+    Size copyTo(char buffer[], Size pos, Size len) const;
+
+	void paste(Size start, Size end, const Rope* r);
+    void paste(Size start, const Rope* r);
 
 	//mark search(const char s[], uint32_t len) const;
     
-	void load(const char filename[]);
-	void save(const char filename[]);
+	void load(const char filename[], LoadMode mode = LoadMode::Read);
+	bool save(const char filename[]);
+
+    void setPageBudget(size_t bytes);
+    size_t getResidentBytes() const;
+
+
+    Size getLength() const;
+    uint32_t getHeight() const;
+
+    Size getLineCount() const;
+    Size offsetOfLine(Size line) const;
+    Size lineOfOffset(Size pos) const;
+    Size offsetOfPosition(Size line, Size column) const;
+    std::pair<Size, Size> positionOfOffset(Size pos) const;
+
+    Size getCharCount() const;
+    Size getUtf16Length() const;
+    Size charOfOffset(Size pos) const;
+    Size offsetOfChar(Size index) const;
+    Size utf16OfOffset(Size pos) const;
+    Size offsetOfUtf16(Size index) const;
+    Size charOfUtf16(Size index) const;
+    Size utf16OfChar(Size index) const;
+
+    uint32_t getLeafCount() const;
+    static size_t getNodeSize();
+    double memoryOverhead() const;
+    bool checkInvariants() const;
+
+    ChunkIterator chunksBegin() const;
+    ChunkIterator chunksEnd() const;
+    ChunkIterator chunksAt(Size pos) const;
+
+    ByteIterator begin() const;
+    ByteIterator end() const;
+    ByteIterator bytesAt(Size pos) const;
+
+    CharIterator charsBegin() const;
+    CharIterator charsEnd() const;
+    CharIterator charsAt(Size pos) const;
 
+    Size find(const char s[], Size len, Size from = 0) const;
 
-    uint32_t getLength() const;
+    char at(Size pos) const;
+    char operator[](Size pos) const;
 
     string toString() const;
 
     void printTree();
 };
 
-#endif // ROPE_HPP
\ No newline at end of file
+#endif // ROPE_HPP
@@ -6,31 +6,59 @@
 */
 
 /**
- * Constructs a new Rope::Node object with the given string and length.
+ * Constructs a new leaf Rope::Node as a slice of a shared buffer.
+ * The node takes over one reference to the buffer, the caller must have retained it.
  *
- * @param str The string to initialize the node with.
- * @param len The length of the string.
+ * @param buffer The arena buffer holding the text, or nullptr for an empty leaf.
+ * @param offset The position of the slice in the buffer.
+ * @param len The length of the slice.
  *
  * @throws None
  */
-Rope::Node::Node(const char str[], uint32_t len) : left(nullptr), right(nullptr), weight(len), height(0), isLeaf(true) 
+Rope::Node::Node(Buffer* buffer, uint32_t offset, uint32_t len) : slice{buffer, offset}, weight(len), refs(1), height(0), isLeaf(true), storage(Storage::Shared)
 {
-    if (len > 0)
-    {
-        data = new char[len+1];
-        std::copy(str, str + len, data);
-        data[len] = '\0';
+    countText();
+}
+
+/**
+ * Constructs a new leaf Rope::Node that needs no buffer. An Inline leaf holds a copy of a short
+ * text in the node itself, so reading it does not follow a pointer. A Mapped leaf points into
+ * a file mapping owned by the arena, which stays valid as long as the arena.
+ *
+ * @param str The text to copy, or the view into the mapping.
+ * @param len The length of the text, at most INLINE_SIZE for an Inline leaf.
+ * @param storage Storage::Inline or Storage::Mapped.
+ *
+ * @throws None
+ */
+Rope::Node::Node(const char* str, uint32_t len, Storage storage) : weight(len), refs(1), height(0), isLeaf(true), storage(storage)
+{
+    if (storage == Storage::Inline) {
+        memcpy(text, str, len);
     }
-    else
-    {
-        data = nullptr;
+    else {
+        view = {str, nullptr};
     }
+    countText();
+}
 
-    length = len;
+/**
+ * Constructs a new Paged leaf Rope::Node, a placeholder for part of a lazily loaded file.
+ * The text is not read, so the counts stay unknown until count() is called.
+ *
+ * @param str The view into the mapping, inside a single page of the pager.
+ * @param len The length of the text.
+ * @param pager The pager of the file, told about every read of the leaf.
+ *
+ * @throws None
+ */
+Rope::Node::Node(const char* str, uint32_t len, Pager* pager) : view{str, pager}, weight(len), lines(0), chars(0), utf16(0), refs(1), height(0), isLeaf(true), storage(Storage::Paged), counted(false)
+{
 }
 
 /**
  * Constructs a new Rope::Node object with the given left and right nodes.
+ * The node takes over one reference to each child.
  *
  * @param left The left child node.
  * @param right The right child node.
@@ -39,18 +67,27 @@ Rope::Node::Node(const char str[], uint32_t len) : left(nullptr), right(nullptr)
  *
  * @throws None
  */
-Rope::Node::Node(Node* left, Node* right) : data(nullptr), length(0), isLeaf(false) 
+Rope::Node::Node(Node* left, Node* right) : children{left, right}, refs(1), isLeaf(false), storage(Storage::Shared)
 {
-    this->left = left;
-    this->right = right;
-
     updateWeight();
     updateHeight();
 }
 
 
+/*
+* Rope::Node member functions
+*   - retain
+*   - release
+*   - updateHeight
+*   - updateWeight
+*   - countText
+*   - addCounts
+*   - count
+*   - balanceFactor
+*/
+
 /**
- * Destructor for Rope::Node class. Deletes the data if it's a leaf node, otherwise recursively deletes the left and right child nodes.
+ * Adds a reference to the current node, marking it as shared once there is more than one.
  *
  * @param None
  *
@@ -58,33 +95,28 @@ Rope::Node::Node(Node* left, Node* right) : data(nullptr), length(0), isLeaf(fal
  *
  * @throws None
  */
-Rope::Node::~Node()
+void Rope::Node::retain()
 {
-    if (isLeaf){
-        if (data)
-            delete[] data;
-        data = nullptr;
-    }
-    else
-    {
-        if (left != nullptr) 
-            delete left;
-
-        if (right != nullptr)
-            delete right;
-    } 
-        
+    refs++;
 }
 
-/*
-* Rope::Node member functions
-*   - updateHeight
-*   - updateWeight
-*   - balanceFactor
-*/
+/**
+ * Drops a reference to the current node. The caller destroys the node once none are left.
+ *
+ * @param None
+ *
+ * @return The number of references left.
+ *
+ * @throws None
+ */
+uint32_t Rope::Node::release()
+{
+    return --refs;
+}
 
 /**
- * Updates the weight of the current node by recursively updating the weights of its children.
+ * Recomputes the weight, the line count and the character counts of the current node from its two children.
+ * Only the node itself is touched, callers refresh the path from an edit up to the root.
  *
  * @param None
  *
@@ -94,44 +126,77 @@ Rope::Node::~Node()
  */
 void Rope::Node::updateWeight()
 {
-    updateWeight(this);
-}
+    if (isLeaf) return; // The weight of a leaf is its length
 
+    const Node* left = children.left;
+    const Node* right = children.right;
+
+    weight = (left != nullptr ? left->weight : 0) + (right != nullptr ? right->weight : 0);
+    lines = (left != nullptr ? left->lines : 0) + (right != nullptr ? right->lines : 0);
+    chars = (left != nullptr ? left->chars : 0) + (right != nullptr ? right->chars : 0);
+    utf16 = (left != nullptr ? left->utf16 : 0) + (right != nullptr ? right->utf16 : 0);
+    counted = (left == nullptr || left->counted) && (right == nullptr || right->counted);
+}
 
 /**
- * Updates the weight of the given node and its subtrees.
+ * Counts the newlines, code points and UTF-16 units in the text of the current leaf in one pass.
+ * Leaves never exceed maxLeafSize, so this is the only place the text is scanned, internal
+ * nodes add up their children. A code point is counted by its lead byte, so a sequence cut
+ * between two leaves is still counted once.
  *
- * @param node The node whose weight needs to be updated.
+ * @param None
  *
- * @return void
+ * @return None
  *
  * @throws None
  */
-void Rope::Node::updateWeight(Node* node)
+void Rope::Node::countText()
 {
-    stack<Node*> nodeStack;
-    nodeStack.push(node);
-
-    while (!nodeStack.empty()) {
-        Node* currNode = nodeStack.top();
-        nodeStack.pop();
-
-        if (currNode == nullptr || currNode->isLeaf || (currNode->left == nullptr && currNode->right == nullptr) ) {continue;}
+    lines = chars = utf16 = 0;
+    addCounts(getData(), getLength(), false);
+    counted = true;
+}
 
-        if (currNode->left != nullptr) {
-            nodeStack.push(currNode->left);
-        }
+/**
+ * Adds the newlines, code points and UTF-16 units of a piece of text to the counts of the
+ * current leaf, or takes them away. Each byte is counted on its own, so the counts of a leaf
+ * can follow an edit by counting only the removed and the inserted bytes.
+ *
+ * @param str The text, may be nullptr if len is 0.
+ * @param len The length of the text.
+ * @param remove Whether to take the counts away instead of adding them.
+ *
+ * @return None
+ *
+ * @throws None
+ */
+void Rope::Node::addCounts(const char* str, uint32_t len, bool remove)
+{
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(str);
+    uint32_t newlines = 0, leads = 0, wide = 0;
 
-        if (currNode->right != nullptr) {
-            nodeStack.push(currNode->right);
-        }
+    for (uint32_t i = 0; i < len; i++) {
+        newlines += data[i] == '\n';
+        leads += (data[i] & 0xC0) != 0x80;
+        wide += data[i] >= 0xF0; // 4-byte sequences need a surrogate pair in UTF-16
+    }
 
-        currNode->weight = (currNode->left != nullptr ? currNode->left->weight : 0) + (currNode->right != nullptr ? currNode->right->weight : 0);
+    if (remove) {
+        lines -= newlines;
+        chars -= leads;
+        utf16 -= leads + wide;
+    }
+    else {
+        lines += newlines;
+        chars += leads;
+        utf16 += leads + wide;
     }
 }
 
 /**
- * Updates the height of the current node by updating the heights of its children.
+ * Fills in the counts of a node that is not counted yet. A leaf scans its text, which reads
+ * a Paged leaf in, and an internal node adds up its children, which must be counted first.
+ * The counts are a cache of the text, so a node shared with other ropes is filled in too.
  *
  * @param None
  *
@@ -139,44 +204,37 @@ void Rope::Node::updateWeight(Node* node)
  *
  * @throws None
  */
-void Rope::Node::updateHeight()
+void Rope::Node::count()
 {
-    updateHeight(this);
+    if (isLeaf) {
+        countText();
+    }
+    else {
+        updateWeight();
+    }
 }
 
 /**
- * Updates the height of the given node and its subtrees.
+ * Recomputes the height of the current node from its two children.
+ * Only the node itself is touched, callers refresh the path from an edit up to the root.
  *
- * @param node The node whose height needs to be updated.
+ * @param None
  *
- * @return void
+ * @return None
  *
  * @throws None
  */
-void Rope::Node::updateHeight(Node* node)
+void Rope::Node::updateHeight()
 {
-    deque<Node*> nodeDeque;
-    nodeDeque.push_back(node);
-
-    while (!nodeDeque.empty()) {
-        Node* currNode = nodeDeque.front();
-        nodeDeque.pop_front();
-        
-        if (currNode == nullptr || currNode->isLeaf || (currNode->left == nullptr && currNode->right == nullptr) ) { continue; }
-
-        if (currNode->left != nullptr) {
-            nodeDeque.push_back(currNode->left);
-        }
-
-        if (currNode->right != nullptr) {
-            nodeDeque.push_back(currNode->right);
-        }
+    if (isLeaf) {
+        height = 0;
+        return;
+    }
 
-        uint32_t leftHeight = (currNode->left ? currNode->left->height : 0);
-        uint32_t rightHeight = (currNode->right ? currNode->right->height : 0);
+    uint32_t leftHeight = (children.left ? children.left->height : 0);
+    uint32_t rightHeight = (children.right ? children.right->height : 0);
 
-        currNode->setHeight((leftHeight > rightHeight) ? leftHeight + 1 : rightHeight + 1);
-    }
+    setHeight((leftHeight > rightHeight) ? leftHeight + 1 : rightHeight + 1);
 }
 
 /**
@@ -207,10 +265,13 @@ int Rope::Node::balanceFactor(Node* node)
 {
     if (node->isLeaf || node == nullptr) return 0;
 
-    if (node->left == nullptr && node->right == nullptr) return 0;
+    const Node* left = node->children.left;
+    const Node* right = node->children.right;
+
+    if (left == nullptr && right == nullptr) return 0;
 
-    int leftHeight = node->left ? node->left->height : 0;
-    int rightHeight = node->right? node->right->height : 0;
+    int leftHeight = left ? left->height : 0;
+    int rightHeight = right ? right->height : 0;
 
     return leftHeight - rightHeight;
 }
@@ -256,8 +317,8 @@ string Rope::Node::toString() const
 {
     string str;
 
-    if (isLeaf && data != nullptr)
-        str = string(data, length);
+    if (isLeaf && getLength() > 0)
+        str = string(getData(), getLength());
     else
         str = "( w:" + to_string(weight) + ", h:" + to_string(height) + " )";  
 
@@ -303,12 +364,12 @@ void Rope::Node::transversePreOrder(string* str, const Node* node) const
             continue;
         }
 
-        if (currNode->right != nullptr) {
-            nodeStack.push(currNode->right);
+        if (currNode->children.right != nullptr) {
+            nodeStack.push(currNode->children.right);
         }
 
-        if (currNode->left != nullptr) {
-            nodeStack.push(currNode->left);
+        if (currNode->children.left != nullptr) {
+            nodeStack.push(currNode->children.left);
         }
     }
 }
@@ -354,10 +415,10 @@ string Rope::Node::treeTransversePreOrder(Node* root)
     }
 
     string pointerRight = "\\__ [R]";
-    string pointerLeft = (root->right != nullptr) ? "|-- [L]" : "\\__ [L]";
+    string pointerLeft = (root->getRight() != nullptr) ? "|-- [L]" : "\\__ [L]";
 
-    treeTransverseNodes(str, "", pointerLeft, root->left, root->right != nullptr);
-    treeTransverseNodes(str, "", pointerRight, root->right, false);
+    treeTransverseNodes(str, "", pointerLeft, root->getLeft(), root->getRight() != nullptr);
+    treeTransverseNodes(str, "", pointerRight, root->getRight(), false);
 
     str->append("\n");
 
@@ -402,10 +463,10 @@ void Rope::Node::treeTransverseNodes(string *str, string padding, string pointer
 
     string paddingForBoth = paddingBuilder;
     string pointerRight = "\\__ [R]";
-    string pointerLeft = (node->right != nullptr) ? "|-- [L]" : "\\__ [L]";
+    string pointerLeft = (node->getRight() != nullptr) ? "|-- [L]" : "\\__ [L]";
 
-    treeTransverseNodes(str, paddingForBoth, pointerLeft, node->left, node->right != nullptr);
-    treeTransverseNodes(str, paddingForBoth, pointerRight, node->right, false);
+    treeTransverseNodes(str, paddingForBoth, pointerLeft, node->getLeft(), node->getRight() != nullptr);
+    treeTransverseNodes(str, paddingForBoth, pointerRight, node->getRight(), false);
 }
 
 
@@ -424,7 +485,7 @@ void Rope::Node::treeTransverseNodes(string *str, string padding, string pointer
  *
  * @throws None
  */
-uint32_t Rope::Node::getWeight() const
+Rope::Size Rope::Node::getWeight() const
 {
     return weight;
 }
@@ -438,11 +499,62 @@ uint32_t Rope::Node::getWeight() const
  *
  * @throws None
  */
-void Rope::Node::setWeight(uint32_t w)
+void Rope::Node::setWeight(Size w)
 {
     this->weight = w;
 }
 
+/**
+ * Retrieves the number of references to the current Rope::Node object.
+ *
+ * @return The reference count, 1 when the node has a single owner and may be modified in place.
+ */
+uint32_t Rope::Node::getRefs() const
+{
+    return refs;
+}
+
+/**
+ * Retrieves the number of newlines in the subtree of the current Rope::Node object.
+ *
+ * @return The newline count.
+ */
+Rope::Size Rope::Node::getLines() const
+{
+    return lines;
+}
+
+/**
+ * Retrieves the number of code points in the subtree of the current Rope::Node object.
+ *
+ * @return The code point count.
+ */
+Rope::Size Rope::Node::getChars() const
+{
+    return chars;
+}
+
+/**
+ * Retrieves the number of UTF-16 code units in the subtree of the current Rope::Node object.
+ *
+ * @return The UTF-16 length.
+ */
+Rope::Size Rope::Node::getUtf16() const
+{
+    return utf16;
+}
+
+/**
+ * Tells whether the counts of the current Rope::Node object are known. They are not while
+ * its subtree holds a Paged leaf that has not been read yet.
+ *
+ * @return true if getLines(), getChars() and getUtf16() cover the whole subtree.
+ */
+bool Rope::Node::getIsCounted() const
+{
+    return counted;
+}
+
 /**
  * Retrieves the height of the current Rope::Node object.
  *
@@ -464,7 +576,7 @@ uint32_t Rope::Node::getHeight() const
  */
 void Rope::Node::setHeight(uint32_t h)
 {
-    this->height = h;
+    this->height = uint8_t(h);
 }
 
 /**
@@ -475,7 +587,7 @@ void Rope::Node::setHeight(uint32_t h)
 Rope::Node* Rope::Node::getLeft() const
 {
     if (!isLeaf) {
-        return left;
+        return children.left;
     }
     else {
         return nullptr;
@@ -493,7 +605,7 @@ Rope::Node* Rope::Node::getLeft() const
  */
 void Rope::Node::setLeft(Node* node) // make sure to update height and weight after setting
 {
-    left = node;
+    children.left = node;
 }
 
 /**
@@ -504,7 +616,7 @@ void Rope::Node::setLeft(Node* node) // make sure to update height and weight af
 Rope::Node* Rope::Node::getRight() const
 {
     if (!isLeaf) {
-        return right;
+        return children.right;
     }
     else {
         return nullptr;
@@ -522,18 +634,29 @@ Rope::Node* Rope::Node::getRight() const
  */
 void Rope::Node::setRight(Node* node)  // make sure to update height and weight after setting
 {
-    right = node;
+    children.right = node;
 }
 
 /**
  * Retrieves the data stored in the current Rope::Node object.
+ * The slice is not null terminated, use getLength() to find its end.
  *
- * @return A pointer to the data if the node is a leaf node, otherwise nullptr.
+ * @return A pointer to the first byte of the slice if the node is a non-empty leaf node, otherwise nullptr.
  */
 char* Rope::Node::getData() const
 {
-    if (getIsLeaf()) {
-        return data;
+    if (storage == Storage::Inline) {
+        return const_cast<char*>(text);
+    }
+    else if (storage == Storage::Mapped) {
+        return const_cast<char*>(view.text); // Mapped read-only, callers only write to unshared buffers
+    }
+    else if (storage == Storage::Paged) {
+        view.pager->touch(view.text); // Keeps the page off the eviction end of the list
+        return const_cast<char*>(view.text);
+    }
+    else if (getIsLeaf() && slice.buffer != nullptr) {
+        return slice.buffer->text() + slice.offset;
     }
     else {
         return nullptr;
@@ -541,8 +664,10 @@ char* Rope::Node::getData() const
 }
 
 /**
- * Sets the data of the Rope::Node object.
+ * Sets the data of the Rope::Node object, releasing the old buffer to the arena.
+ * Text of up to INLINE_SIZE bytes is kept in the node.
  *
+ * @param arena The arena owning this node's buffer.
  * @param str The string to set as the data.
  * @param len The length of the string.
  *
@@ -550,24 +675,103 @@ char* Rope::Node::getData() const
  *
  * @throws None
  */
-void Rope::Node::setData(const char* str, uint32_t len)
+void Rope::Node::setData(Arena& arena, const char* str, uint32_t len)
 {
-    if (getIsLeaf()) {
-        
-        if (data != nullptr) {
-            delete[] data;
+    if (!getIsLeaf()) return;
+
+    arena.release(getBuffer());
+
+    storage = len > 0 && len <= INLINE_SIZE ? Storage::Inline : Storage::Shared;
+    if (storage == Storage::Inline) {
+        copy (str, str + len, text);
+    }
+    else {
+        slice.buffer = len > 0 ? arena.createBuffer(len) : nullptr;
+        if (slice.buffer != nullptr) {
+            copy (str, str + len, slice.buffer->text());
         }
+        slice.offset = 0;
+    }
+    setLength(len);
+}
 
-        data = new char[len+1];
-        copy (str, str + len, data);
-        data[len] = '\0';
-        setLength(len);
+/**
+ * Replaces a range of the text of the current leaf with a string. When the leaf is the only
+ * user of its buffer and the result fits in the buffer, or the leaf is inline and the result
+ * still fits in the node, the bytes are moved in place. Otherwise the leaf moves to a new
+ * buffer with some slack for the next edits, which is also how a view into a mapped file
+ * becomes a heap leaf on its first edit. A Paged leaf is counted before the edit.
+ * The counts only scan the removed and the inserted bytes.
+ * The caller makes sure the range lies inside the leaf and the leaf is not shared.
+ *
+ * @param arena The arena the leaf belongs to.
+ * @param pos The position of the range in the leaf.
+ * @param removed The length of the range.
+ * @param str The string to insert in its place.
+ * @param len The length of the string.
+ * @param slack The spare bytes to reserve when a new buffer is needed.
+ *
+ * @return None
+ *
+ * @throws std::bad_alloc if the arena cannot grow.
+ */
+void Rope::Node::editText(Arena& arena, uint32_t pos, uint32_t removed, const char* str, uint32_t len, uint32_t slack)
+{
+    if (!isLeaf) return;
 
+    if (!counted) {
+        countText();
+    }
+
+    char* data = getData();
+    uint32_t length = getLength();
+    uint32_t tail = length - pos - removed;
+    uint32_t newLength = length - removed + len;
+
+    addCounts(data + pos, removed, true);
+    addCounts(str, len, false);
+
+    Buffer* buffer = getBuffer();
+    bool fits = storage == Storage::Inline ? newLength <= INLINE_SIZE
+              : buffer != nullptr && buffer->refs == 1 && slice.offset + newLength <= buffer->size;
+
+    if (fits) {
+        memmove(data + pos + len, data + pos + removed, tail);
+        copy(str, str + len, data + pos);
     }
     else {
-        data = nullptr;
-        setLength(0);
+        Buffer* newBuffer = arena.createBuffer(newLength + slack);
+        copy(data, data + pos, newBuffer->text());
+        copy(str, str + len, newBuffer->text() + pos);
+        copy(data + pos + removed, data + pos + removed + tail, newBuffer->text() + pos + len);
+
+        arena.release(buffer);
+        storage = Storage::Shared;
+        slice.buffer = newBuffer;
+        slice.offset = 0;
     }
+
+    weight = newLength;
+}
+
+/**
+ * Retrieves the shared buffer the current Rope::Node object slices.
+ *
+ * @return A pointer to the buffer if the node is a non-empty leaf node with its text out of line, otherwise nullptr.
+ */
+Rope::Buffer* Rope::Node::getBuffer() const
+{
+    return isLeaf && storage == Storage::Shared ? slice.buffer : nullptr;
+}
+
+/**
+ * Retrieves the position of the current Rope::Node object's slice in its buffer.
+ *
+ * @return The offset of the slice if the node is a leaf node with a buffer, otherwise 0.
+ */
+uint32_t Rope::Node::getOffset() const
+{
+    return isLeaf && storage == Storage::Shared ? slice.offset : 0;
 }
 
 /**
@@ -577,7 +781,7 @@ void Rope::Node::setData(const char* str, uint32_t len)
  */
 uint32_t Rope::Node::getLength() const
 {
-    return isLeaf ? length : 0;
+    return isLeaf ? uint32_t(weight) : 0;
 }
 
 /**
@@ -593,8 +797,8 @@ void Rope::Node::setLength(uint32_t len)
 {
     if (!isLeaf) return;
 
-    length = len;
     weight = len;
+    countText();
 }
 
 /**
@@ -605,4 +809,25 @@ void Rope::Node::setLength(uint32_t len)
 bool Rope::Node::getIsLeaf() const
 {
     return isLeaf;
-}
\ No newline at end of file
+}
+
+/**
+ * Tells whether the current Rope::Node object is a leaf viewing a mapped file, lazily loaded or not.
+ *
+ * @return true if the leaf text lives in a file mapping, false otherwise.
+ */
+bool Rope::Node::getIsMapped() const
+{
+    return isLeaf && (storage == Storage::Mapped || storage == Storage::Paged);
+}
+
+/**
+ * Retrieves the pager of a Paged leaf.
+ *
+ * @return The pager, or nullptr if the node is not a Paged leaf.
+ */
+Rope::Pager* Rope::Node::getPager() const
+{
+    return isLeaf && storage == Storage::Paged ? view.pager : nullptr;
+}
+
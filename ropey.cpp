@@ -36,6 +36,7 @@ Ropey::Ropey(QWidget *parent)
 
 Ropey::~Ropey()
 {
+    Rope::reclaim(rope);
     delete ui;
 }
 
@@ -150,12 +151,14 @@ void Ropey::newFile()
     qDebug() << "new file button";
     if (maybeSave()) {
         qDebug() << "Deleting rope 1";
+        Rope::reclaim(rope); // Freed off the UI thread
         rope = new Rope();
         qDebug() << "clear text area 1";
         ui->textEdit->clear();
         setCurrentFile(QString());
     }
     qDebug() << "Deleting rope";
+    Rope::reclaim(rope);
     rope = new Rope();
     qDebug() << "clear text area";
     ui->textEdit->clear();
@@ -321,18 +324,42 @@ void Ropey::handleTextChanged() {
 
     qDebug() << "Invoked handle text";
     string curStr = ui->textEdit->toPlainText().toStdString();
-    string prevStr = rope->toString();
-    auto operations = diff(prevStr, curStr);
 
-    for (auto& op : operations) {
-        if (op.isInsertion) {
-            rope->insert(op.pos, op.text.c_str(), op.text.length());
+    // Only the span between the common prefix and suffix changed, so walk the rope
+    // in place to find it and diff just that span instead of the whole document
+    Rope::Size length = rope->getLength();
+    Rope::Size prefix = 0;
+    for (Rope::ByteIterator it = rope->begin(); !it.atEnd() && prefix < curStr.size() && *it == curStr[prefix]; ++it) {
+        prefix++;
+    }
+
+    Rope::Size suffix = 0;
+    Rope::ByteIterator back = rope->end();
+    while (suffix < length - prefix && suffix < curStr.size() - prefix && *(--back) == curStr[curStr.size() - 1 - suffix]) {
+        suffix++;
+    }
+
+    string prevStr(rope->bytesAt(prefix), rope->bytesAt(length - suffix));
+    string midStr = curStr.substr(prefix, curStr.size() - prefix - suffix);
+    auto operations = diff(prevStr, midStr);
+
+    // diff() lists the changes from the end of the text backwards, apply them as one sorted
+    // batch, a deletion and an insertion at the same position become one replacement
+    vector<Rope::Edit> edits;
+    for (auto op = operations.rbegin(); op != operations.rend(); ++op) {
+        Rope::Size pos = prefix + op->pos;
+        if (edits.empty() || edits.back().pos != pos) {
+            edits.push_back({pos, 0, string_view()});
+        }
+
+        if (op->isInsertion) {
+            edits.back().text = op->text;
         } else {
-            rope->remove(op.pos, op.text.size());
+            edits.back().removed = op->text.size();
         }
     }
 
-    qDebug() << "Rope toString : " << rope->toString();
+    rope->applyEdits(edits);
 
     ui->textEdit->setPlainText(curStr.c_str());
 
@@ -355,6 +382,7 @@ void Ropey::loadFile(const QString &fileName)
         return;
     }
 
+    Rope::reclaim(rope); // The previous document is freed off the UI thread
     rope = new Rope(fileName.toStdString().c_str());
     QTextStream in(&file);
 #ifndef QT_NO_CURSOR